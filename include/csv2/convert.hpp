@@ -0,0 +1,425 @@
+#pragma once
+#include <cfloat>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+	#include <string_view>
+#endif
+
+namespace csv2 {
+
+namespace detail {
+
+#if defined(_MSC_VER) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define __CSV2_SWAR_DIGITS__ 1
+#endif
+
+inline bool is_digit(char c) { return static_cast<unsigned char>(c) - unsigned('0') <= 9; }
+
+#if __CSV2_SWAR_DIGITS__
+// True if all eight bytes of `chunk` are ASCII digits
+inline bool is_eight_digits(uint64_t chunk) {
+  return ((chunk & 0xF0F0F0F0F0F0F0F0ULL) |
+          (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ==
+         0x3333333333333333ULL;
+}
+
+// Converts eight ASCII digits (little-endian load) to their value
+// with three multiplications instead of eight
+inline uint32_t parse_eight_digits(uint64_t chunk) {
+  const uint64_t mask = 0x000000FF000000FFULL;
+  const uint64_t mul1 = 0x000F424000000064ULL; // 100 + (1000000 << 32)
+  const uint64_t mul2 = 0x0000271000000001ULL; // 1 + (10000 << 32)
+  chunk -= 0x3030303030303030ULL;
+  chunk = (chunk * 10) + (chunk >> 8);
+  chunk = (((chunk & mask) * mul1) + (((chunk >> 16) & mask) * mul2)) >> 32;
+  return static_cast<uint32_t>(chunk);
+}
+#endif
+
+// Accumulates the digits at `first` into `mantissa`; returns false if
+// more than 19 significant digits are seen
+inline bool parse_digits(const char *&first, const char *last, uint64_t &mantissa,
+                         size_t &digits) {
+#if __CSV2_SWAR_DIGITS__
+  uint64_t chunk;
+  while (last - first >= 8 && (memcpy(&chunk, first, 8), is_eight_digits(chunk))) {
+    if (digits + 8 > 19)
+      return false;
+    mantissa = mantissa * 100000000ULL + parse_eight_digits(chunk);
+    digits += 8;
+    first += 8;
+  }
+#endif
+  for (; first != last && is_digit(*first); ++first) {
+    if (++digits > 19)
+      return false;
+    mantissa = mantissa * 10 + static_cast<unsigned>(*first - '0');
+  }
+  return true;
+}
+
+// Clinger's fast path: decimal numbers with at most 19 significant digits,
+// a mantissa below 2^53 and a power of ten within [-22, 22] convert exactly
+// with one floating-point multiplication or division. Returns false for
+// everything else (which is left to strtod)
+inline bool parse_double_fast(const char *first, const char *last, double &result) {
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+  static const double powers_of_ten[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                         1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                         1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  bool negative = false;
+  if (first != last && (*first == '-' || *first == '+')) {
+    negative = (*first == '-');
+    ++first;
+  }
+
+  uint64_t mantissa = 0;
+  size_t digits = 0;
+  long exponent = 0;
+  if (!parse_digits(first, last, mantissa, digits))
+    return false;
+  if (first != last && *first == '.') {
+    const char *fraction = ++first;
+    if (!parse_digits(first, last, mantissa, digits))
+      return false;
+    exponent -= static_cast<long>(first - fraction);
+  }
+  if (digits == 0)
+    return false;
+
+  if (first != last && (*first == 'e' || *first == 'E')) {
+    ++first;
+    bool negative_exponent = false;
+    if (first != last && (*first == '-' || *first == '+')) {
+      negative_exponent = (*first == '-');
+      ++first;
+    }
+    if (first == last || last - first > 4)
+      return false;
+    long value = 0;
+    for (; first != last && is_digit(*first); ++first)
+      value = value * 10 + (*first - '0');
+    exponent += negative_exponent ? -value : value;
+  }
+
+  if (first != last || mantissa > (1ULL << 53) || exponent < -22 || exponent > 22)
+    return false;
+  double value = static_cast<double>(mantissa);
+  value = exponent < 0 ? value / powers_of_ten[-exponent] : value * powers_of_ten[exponent];
+  result = negative ? -value : value;
+  return true;
+#else
+  (void)(first), (void)(last), (void)(result);
+  return false;
+#endif
+}
+
+#if __CSV2_SWAR_DIGITS__
+// Checks eight bytes against a fixed layout of digits and separators in
+// one go: byte b is valid if b + add_low sets and b + add_high clears
+// the high bit, i.e., add_low = 0x80 - lowest and add_high = 0x7F - highest
+inline bool matches_layout(const char *first, uint64_t add_low, uint64_t add_high) {
+  uint64_t chunk;
+  memcpy(&chunk, first, 8);
+  const uint64_t high_bits = 0x8080808080808080ULL;
+  return ((chunk + add_low) & ~(chunk + add_high) & ~chunk & high_bits) == high_bits;
+}
+#endif
+
+// Checks characters against a layout where '9' stands for any digit
+inline bool matches_layout(const char *first, const char *layout, size_t length) {
+  for (size_t i = 0; i < length; ++i)
+    if (layout[i] == '9' ? !is_digit(first[i]) : first[i] != layout[i])
+      return false;
+  return true;
+}
+
+inline int two_digits(const char *first) { return (first[0] - '0') * 10 + (first[1] - '0'); }
+
+// Days since 1970-01-01 in the proleptic Gregorian calendar (H. Hinnant)
+inline int64_t days_from_civil(int64_t year, unsigned month, unsigned day) {
+  year -= month <= 2;
+  const int64_t era = (year >= 0 ? year : year - 399) / 400;
+  const unsigned year_of_era = static_cast<unsigned>(year - era * 400);
+  const unsigned day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  const unsigned day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + static_cast<int64_t>(day_of_era) - 719468;
+}
+
+inline unsigned days_in_month(int64_t year, unsigned month) {
+  static const unsigned char days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  const bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+  return days[month - 1] + unsigned(month == 2 && leap);
+}
+
+} // namespace detail
+
+// Set of tokens that mark a missing value, e.g., "", NA, NULL or \N
+// Tokens shorter than 8 bytes are packed, together with their length,
+// into one 64-bit word each, so that matching a short cell costs one
+// load and one integer compare per token
+class NullValues {
+  std::vector<uint64_t> short_tokens_;   // packed tokens shorter than 8 bytes
+  std::vector<std::string> long_tokens_; // everything else
+
+  static uint64_t pack_(const char *first, size_t length) {
+    char bytes[8] = {0};
+    memcpy(bytes, first, length);
+    bytes[7] = static_cast<char>(length);
+    uint64_t result;
+    memcpy(&result, bytes, 8);
+    return result;
+  }
+
+public:
+  NullValues() : NullValues({"", "NA", "NULL", "\\N"}) {}
+
+  NullValues(std::initializer_list<std::string> tokens) {
+    for (const auto &token : tokens) {
+      if (token.size() < 8)
+        short_tokens_.push_back(pack_(token.data(), token.size()));
+      else
+        long_tokens_.push_back(token);
+    }
+  }
+
+  // True if the (trimmed) cell characters [first, last) are a null token
+  bool contains(const char *first, const char *last) const {
+    const size_t length = last - first;
+    if (length < 8) {
+      const uint64_t packed = pack_(first, length);
+      for (const auto token : short_tokens_)
+        if (token == packed)
+          return true;
+      return false;
+    }
+    for (const auto &token : long_tokens_)
+      if (token.size() == length && memcmp(token.data(), first, length) == 0)
+        return true;
+    return false;
+  }
+};
+
+// Point in time as nanoseconds since 1970-01-01T00:00:00Z
+struct timestamp {
+  int64_t nanoseconds;
+};
+
+// Parses the (trimmed) cell characters [first, last) into `result`
+// Returns false if the characters do not form a valid value
+// Specialize csv2::convert<T> to read your own types from cells
+template <typename T, typename Enable = void> struct convert {
+  static_assert(!std::is_same<T, T>::value, "csv2::convert<T> is not specialized for this type");
+};
+
+template <typename T>
+struct convert<T, typename std::enable_if<std::is_integral<T>::value &&
+                                          !std::is_same<T, bool>::value>::type> {
+  static bool parse(const char *first, const char *last, T &result) {
+    typedef typename std::make_unsigned<T>::type unsigned_type;
+    bool negative = false;
+    if (first != last && (*first == '-' || *first == '+')) {
+      negative = (*first == '-');
+      ++first;
+    }
+    if (first == last || (negative && std::is_unsigned<T>::value))
+      return false;
+
+    const unsigned_type limit =
+        unsigned_type(std::numeric_limits<T>::max()) + unsigned_type(negative ? 1 : 0);
+    unsigned_type value = 0;
+    for (; first != last; ++first) {
+      const unsigned digit = static_cast<unsigned char>(*first) - unsigned('0');
+      if (digit > 9 || value > (limit - digit) / 10)
+        return false;
+      value = static_cast<unsigned_type>(value * 10 + digit);
+    }
+    if (negative && value != 0)
+      result = static_cast<T>(-static_cast<T>(value - 1) - 1);
+    else
+      result = static_cast<T>(value);
+    return true;
+  }
+};
+
+template <typename T>
+struct convert<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+  static bool parse(const char *first, const char *last, T &result) {
+    const size_t length = last - first;
+    if (length == 0)
+      return false;
+    if (parse_fast_(first, last, result))
+      return true;
+
+    // strtod et al. need a null-terminated input
+    char buffer[64];
+    std::string long_buffer;
+    const char *input = buffer;
+    if (length < sizeof(buffer)) {
+      memcpy(buffer, first, length);
+      buffer[length] = '\0';
+    } else {
+      long_buffer.assign(first, last);
+      input = long_buffer.c_str();
+    }
+
+    char *end = nullptr;
+    result = strto_(input, &end, static_cast<T *>(nullptr));
+    return end == input + length;
+  }
+
+private:
+  static bool parse_fast_(const char *first, const char *last, double &result) {
+    return detail::parse_double_fast(first, last, result);
+  }
+  template <typename U> static bool parse_fast_(const char *, const char *, U &) {
+    return false;
+  }
+
+  static float strto_(const char *input, char **end, float *) { return strtof(input, end); }
+  static double strto_(const char *input, char **end, double *) { return strtod(input, end); }
+  static long double strto_(const char *input, char **end, long double *) {
+    return strtold(input, end);
+  }
+};
+
+template <> struct convert<bool> {
+  static bool parse(const char *first, const char *last, bool &result) {
+    const size_t length = last - first;
+    if (length == 1 && (*first == '0' || *first == '1')) {
+      result = (*first == '1');
+      return true;
+    }
+    if (equals_(first, length, "true", 4) || equals_(first, length, "false", 5)) {
+      result = (length == 4);
+      return true;
+    }
+    return false;
+  }
+
+private:
+  // Case-insensitive comparison against a lowercase literal
+  static bool equals_(const char *first, size_t length, const char *literal, size_t n) {
+    if (length != n)
+      return false;
+    for (size_t i = 0; i < n; ++i)
+      if ((first[i] | 0x20) != literal[i])
+        return false;
+    return true;
+  }
+};
+
+// Parses YYYY-MM-DD[(T| )HH:MM[:SS[.fffffffff]]][Z|(+|-)hh[:mm]]
+// All fields sit at fixed offsets, so the date and the time of day are
+// each validated with a single eight-byte layout check
+template <> struct convert<timestamp> {
+  static bool parse(const char *first, const char *last, timestamp &result) {
+    const size_t length = last - first;
+    if (length < 10 || !date_(first))
+      return false;
+    const int64_t year = detail::two_digits(first) * 100 + detail::two_digits(first + 2);
+    const unsigned month = detail::two_digits(first + 5), day = detail::two_digits(first + 8);
+    if (month < 1 || month > 12 || day < 1 || day > detail::days_in_month(year, month))
+      return false;
+
+    int64_t seconds = detail::days_from_civil(year, month, day) * 86400, nanoseconds = 0;
+    const char *p = first + 10;
+    if (p != last) {
+      if ((*p != 'T' && *p != 't' && *p != ' ') || last - p < 6)
+        return false;
+      const char *time = p + 1;
+      int secs = 0;
+      if (last - p >= 9 && p[6] == ':') {
+        if (!time_(time))
+          return false;
+        secs = detail::two_digits(time + 6);
+        p += 9;
+      } else {
+        if (!detail::matches_layout(time, "99:99", 5))
+          return false;
+        p += 6;
+      }
+      const int hours = detail::two_digits(time), minutes = detail::two_digits(time + 3);
+      if (hours > 23 || minutes > 59 || secs > 59)
+        return false;
+      seconds += hours * 3600 + minutes * 60 + secs;
+
+      if (p != last && *p == '.') {
+        const char *fraction = ++p;
+        int64_t scale = 1000000000;
+        for (; p != last && detail::is_digit(*p); ++p)
+          if (scale > 1)
+            nanoseconds += (*p - '0') * (scale /= 10);
+        if (p == fraction)
+          return false;
+      }
+
+      if (p != last && (*p == 'Z' || *p == 'z')) {
+        ++p;
+      } else if (p != last && (*p == '+' || *p == '-')) {
+        const int64_t sign = (*p == '+') ? -1 : 1;
+        const size_t zone = last - p - 1;
+        if (zone == 2 && detail::matches_layout(p + 1, "99", 2))
+          seconds += sign * detail::two_digits(p + 1) * 3600;
+        else if (zone == 5 && detail::matches_layout(p + 1, "99:99", 5))
+          seconds += sign * (detail::two_digits(p + 1) * 3600 + detail::two_digits(p + 4) * 60);
+        else if (zone == 4 && detail::matches_layout(p + 1, "9999", 4))
+          seconds += sign * (detail::two_digits(p + 1) * 3600 + detail::two_digits(p + 3) * 60);
+        else
+          return false;
+        p = last;
+      }
+      if (p != last)
+        return false;
+    }
+    result.nanoseconds = seconds * 1000000000 + nanoseconds;
+    return true;
+  }
+
+private:
+  // YYYY-MM-DD
+  static bool date_(const char *first) {
+#if __CSV2_SWAR_DIGITS__
+    // "9999-99-": digits need [0x30, 0x39], dashes exactly 0x2D
+    return detail::matches_layout(first, 0x5350505350505050ULL, 0x5246465246464646ULL) &&
+           detail::is_digit(first[8]) && detail::is_digit(first[9]);
+#else
+    return detail::matches_layout(first, "9999-99-99", 10);
+#endif
+  }
+
+  // HH:MM:SS
+  static bool time_(const char *first) {
+#if __CSV2_SWAR_DIGITS__
+    // "99:99:99": digits need [0x30, 0x39], colons exactly 0x3A
+    return detail::matches_layout(first, 0x5050465050465050ULL, 0x4646454646454646ULL);
+#else
+    return detail::matches_layout(first, "99:99:99", 8);
+#endif
+  }
+};
+
+template <> struct convert<std::string> {
+  static bool parse(const char *first, const char *last, std::string &result) {
+    result.assign(first, last);
+    return true;
+  }
+};
+
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+template <> struct convert<std::string_view> {
+  static bool parse(const char *first, const char *last, std::string_view &result) {
+    result = std::string_view(first, last - first);
+    return true;
+  }
+};
+#endif
+
+} // namespace csv2
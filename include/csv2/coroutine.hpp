@@ -0,0 +1,243 @@
+#pragma once
+// Coroutine interface (C++20): csv2::generator<T>, csv2::rows(reader) and
+// the awaitable csv2::async_follower. Compiles to nothing before C++20
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 202002L) || __cplusplus >= 202002L) &&              \
+    __has_include(<coroutine>) && __has_include(<stop_token>)
+#define __CSV2_HAS_COROUTINES__ 1
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <csv2/follow.hpp>
+#include <csv2/reader.hpp>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace csv2 {
+
+// Lazy sequence of T produced by a coroutine with co_yield. There is one
+// coroutine frame per generator; yielded values are referenced in place,
+// not copied. Destroying the generator cancels the coroutine
+template <class T> class generator {
+public:
+  struct promise_type {
+    const T *current_{nullptr};
+    std::exception_ptr exception_;
+
+    generator get_return_object() {
+      return generator(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    std::suspend_always yield_value(const T &value) noexcept {
+      current_ = std::addressof(value);
+      return {};
+    }
+    void return_void() noexcept {}
+    void unhandled_exception() { exception_ = std::current_exception(); }
+    template <class U> void await_transform(U &&) = delete; // no co_await in generators
+  };
+
+  class iterator {
+    std::coroutine_handle<promise_type> handle_;
+
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = T;
+
+    iterator() = default;
+    explicit iterator(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    iterator &operator++() {
+      handle_.resume();
+      if (handle_.done() && handle_.promise().exception_)
+        std::rethrow_exception(handle_.promise().exception_);
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+
+    const T &operator*() const { return *handle_.promise().current_; }
+
+    bool operator==(std::default_sentinel_t) const { return !handle_ || handle_.done(); }
+  };
+
+  generator(generator &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+  generator &operator=(generator &&other) noexcept {
+    if (this != &other) {
+      if (handle_)
+        handle_.destroy();
+      handle_ = std::exchange(other.handle_, {});
+    }
+    return *this;
+  }
+  generator(const generator &) = delete;
+  generator &operator=(const generator &) = delete;
+
+  ~generator() {
+    if (handle_)
+      handle_.destroy();
+  }
+
+  iterator begin() {
+    iterator result(handle_);
+    if (handle_)
+      ++result;
+    return result;
+  }
+  std::default_sentinel_t end() const noexcept { return {}; }
+
+private:
+  explicit generator(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+  std::coroutine_handle<promise_type> handle_;
+};
+
+// The rows visited by reader.begin()..reader.end(), as a generator; stops
+// early once `token` is stopped
+template <class Reader>
+generator<typename Reader::Row> rows(const Reader &reader, std::stop_token token = {}) {
+  for (auto it = reader.begin(), last = reader.end(); it != last && !token.stop_requested(); ++it)
+    co_yield *it;
+}
+
+// Awaitable follow mode for a Reader that mmap'ed `path`:
+//
+//   async_follower<Reader> follower(csv, "log.csv");
+//   for (;;) {
+//     auto rows = co_await follower.next(token);
+//     if (rows.empty()) break;   // stopped
+//     ...
+//   }
+//
+// next() completes right away if rows were appended already; otherwise it
+// suspends the coroutine, and the follower's waiter thread waits for
+// appends (FileWatcher) and then resumes the coroutine with the new rows.
+// It resumes with no rows once `token` is stopped. One coroutine at a time
+// may await a follower. Destroying the follower stops and joins the waiter
+// thread, and a suspended coroutine is then never resumed; destroying a
+// suspended coroutine withdraws its wait
+template <class Reader> class async_follower {
+public:
+  typedef typename Reader::Row Row;
+
+private:
+  // Shared with awaiters, which may outlive the follower
+  struct state {
+    std::mutex mutex;
+    std::condition_variable_any waiting;
+    std::coroutine_handle<> pending; // suspended coroutine, if any
+    std::stop_token token;           // of the pending wait
+    std::vector<Row> rows;           // rows for the pending wait
+  };
+
+  Reader &reader_;
+  FileWatcher watcher_;
+  std::chrono::milliseconds interval_; // how often `token` is checked
+  std::shared_ptr<state> state_;
+  std::jthread waiter_; // last member: stopped and joined first
+
+  // Collects the rows appended since the last call; state_->mutex is held
+  bool poll_() {
+    reader_.follow([this](const Row &row) { state_->rows.push_back(row); });
+    return !state_->rows.empty();
+  }
+
+  void wait_(std::stop_token stop) {
+    const std::shared_ptr<state> shared = state_;
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    while (!stop.stop_requested()) {
+      if (!shared->pending) {
+        shared->waiting.wait(lock, stop, [&shared]() { return bool(shared->pending); });
+        continue;
+      }
+      lock.unlock();
+      watcher_.wait(interval_);
+      lock.lock();
+      if (!shared->pending || (!shared->token.stop_requested() && !poll_()))
+        continue;
+      const auto handle = std::exchange(shared->pending, {});
+      lock.unlock();
+      handle.resume();
+      if (stop.stop_requested())
+        return; // the follower may be gone
+      lock.lock();
+    }
+  }
+
+public:
+  async_follower(Reader &reader, std::string path,
+                 std::chrono::milliseconds interval = std::chrono::milliseconds(100))
+      : reader_(reader), watcher_(std::move(path)), interval_(interval),
+        state_(std::make_shared<state>()) {}
+
+  async_follower(const async_follower &) = delete;
+  async_follower &operator=(const async_follower &) = delete;
+
+  ~async_follower() {
+    // destroyed by the coroutine the waiter thread resumed: let it finish
+    if (waiter_.joinable() && waiter_.get_id() == std::this_thread::get_id()) {
+      waiter_.request_stop();
+      waiter_.detach();
+    }
+  }
+
+  class awaiter {
+    async_follower *follower_;
+    std::shared_ptr<state> state_;
+    std::stop_token token_;
+    std::coroutine_handle<> handle_;
+
+  public:
+    awaiter(async_follower *follower, std::stop_token token)
+        : follower_(follower), state_(follower->state_), token_(std::move(token)) {}
+    awaiter(const awaiter &) = delete;
+    awaiter &operator=(const awaiter &) = delete;
+
+    // withdraws the wait if the coroutine is destroyed while suspended
+    ~awaiter() {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      if (handle_ && state_->pending == handle_)
+        state_->pending = {};
+    }
+
+    bool await_ready() {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      return token_.stop_requested() || follower_->poll_();
+    }
+
+    // the coroutine may be resumed before this returns, so the awaiter is
+    // not used after the handle is published
+    void await_suspend(std::coroutine_handle<> handle) {
+      handle_ = handle;
+      async_follower *follower = follower_;
+      const std::shared_ptr<state> shared = state_;
+      std::lock_guard<std::mutex> lock(shared->mutex);
+      shared->pending = handle;
+      shared->token = token_;
+      if (!follower->waiter_.joinable())
+        follower->waiter_ =
+            std::jthread([follower](std::stop_token stop) { follower->wait_(std::move(stop)); });
+      shared->waiting.notify_one();
+    }
+
+    std::vector<Row> await_resume() {
+      std::vector<Row> result;
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      result.swap(state_->rows);
+      return result;
+    }
+  };
+
+  // Rows appended since the last call (see Reader::follow); valid until the
+  // next call
+  awaiter next(std::stop_token token = {}) { return awaiter(this, std::move(token)); }
+};
+
+} // namespace csv2
+#endif
@@ -0,0 +1,91 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#if __has_include(<sys/inotify.h>)
+#define __CSV2_HAS_INOTIFY__ 1
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace csv2 {
+
+// Waits for appends to a file, for use with Reader::follow():
+//
+//   FileWatcher watcher("log.csv");
+//   while (running) {
+//     watcher.wait(std::chrono::milliseconds(500));
+//     csv.follow([](const auto &row) { ... });
+//   }
+//
+// Uses inotify where available, and falls back to polling the file size
+class FileWatcher {
+  std::string path_;                   // watched file
+  std::chrono::milliseconds interval_; // polling interval
+  std::streamoff size_{0};             // last seen file size (polling)
+  int fd_{-1};                         // inotify instance, -1 = polling
+
+public:
+  explicit FileWatcher(std::string path,
+                       std::chrono::milliseconds interval = std::chrono::milliseconds(10))
+      : path_(std::move(path)), interval_(interval), size_(size_of_(path_)) {
+#if __CSV2_HAS_INOTIFY__
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ >= 0 && inotify_add_watch(fd_, path_.c_str(), IN_MODIFY) < 0) {
+      close(fd_);
+      fd_ = -1;
+    }
+#endif
+  }
+
+  FileWatcher(const FileWatcher &) = delete;
+  FileWatcher &operator=(const FileWatcher &) = delete;
+
+  ~FileWatcher() {
+#if __CSV2_HAS_INOTIFY__
+    if (fd_ >= 0)
+      close(fd_);
+#endif
+  }
+
+  // Blocks until the file is modified or `timeout` expires; returns true if
+  // the file was modified
+  bool wait(std::chrono::milliseconds timeout) {
+#if __CSV2_HAS_INOTIFY__
+    if (fd_ >= 0) {
+      pollfd request{fd_, POLLIN, 0};
+      if (poll(&request, 1, static_cast<int>(timeout.count())) <= 0)
+        return false;
+      // drain the queued events
+      char events[4096];
+      while (read(fd_, events, sizeof(events)) > 0) {
+      }
+      return true;
+    }
+#endif
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    for (;;) {
+      const std::streamoff size = size_of_(path_);
+      if (size != size_) {
+        size_ = size;
+        return true;
+      }
+      const auto now = std::chrono::steady_clock::now();
+      if (now >= deadline)
+        return false;
+      std::this_thread::sleep_for(
+          std::min<std::chrono::steady_clock::duration>(interval_, deadline - now));
+    }
+  }
+
+private:
+  static std::streamoff size_of_(const std::string &path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    return file ? static_cast<std::streamoff>(file.tellg()) : 0;
+  }
+};
+
+} // namespace csv2
@@ -0,0 +1,137 @@
+#pragma once
+#include <csv2/parallel.hpp>
+#include <csv2/reader.hpp>
+#include <vector>
+
+namespace csv2 {
+
+enum class layout { row_major, column_major };
+
+template <typename T> class Matrix;
+
+template <typename T, class Reader>
+Matrix<T> load_matrix(const Reader &reader, layout order = layout::row_major,
+                      size_t threads = 0, const NullValues &nulls = NullValues());
+
+template <typename T> class Matrix {
+public:
+  // Cell that could not be converted (left as T{} in the matrix)
+  struct Failure {
+    size_t row;
+    size_t col;
+  };
+
+  Matrix(size_t rows, size_t cols, layout order)
+      : rows_(rows), cols_(cols), order_(order), data_(rows * cols),
+        validity_((rows * cols + 63) / 64, ~uint64_t(0)), null_count_(0) {}
+
+  size_t rows() const { return rows_; }
+  size_t cols() const { return cols_; }
+  layout order() const { return order_; }
+
+  T &operator()(size_t row, size_t col) { return data_[index(row, col)]; }
+  const T &operator()(size_t row, size_t col) const { return data_[index(row, col)]; }
+
+  // Contiguous storage, in row-major or column-major order
+  T *data() { return data_.data(); }
+  const T *data() const { return data_.data(); }
+
+  // Failed cells, in file order
+  const std::vector<Failure> &failures() const { return failures_; }
+
+  // Validity bitmap: bit (i % 64) of word i / 64 is cleared if the cell
+  // stored at data()[i] is null or failed to convert
+  const std::vector<uint64_t> &validity() const { return validity_; }
+  bool is_valid(size_t row, size_t col) const {
+    const size_t i = index(row, col);
+    return (validity_[i / 64] >> (i % 64)) & 1;
+  }
+
+  // Number of cells that matched a null token
+  size_t null_count() const { return null_count_; }
+
+private:
+  template <typename U, class Reader>
+  friend Matrix<U> load_matrix(const Reader &, layout, size_t, const NullValues &);
+
+  void invalidate_(size_t i) { validity_[i / 64] &= ~(uint64_t(1) << (i % 64)); }
+
+  size_t index(size_t row, size_t col) const {
+    return order_ == layout::row_major ? row * cols_ + col : col * rows_ + row;
+  }
+
+  size_t rows_;
+  size_t cols_;
+  layout order_;
+  std::vector<T> data_;
+  std::vector<Failure> failures_;
+  std::vector<uint64_t> validity_;
+  size_t null_count_;
+};
+
+// Loads every (non-empty) data row of `reader` into a dense matrix with
+// reader.cols() columns. The buffer is split into record-aligned chunks
+// that are parsed in parallel: a first pass counts the rows of every chunk
+// so that the second pass can convert cells straight into their final
+// location. Cells matching one of the `nulls` tokens are left as T{} and
+// cleared in the validity bitmap. Cells that are missing or fail to convert
+// are cleared too and reported in Matrix::failures(); extra cells are ignored
+template <typename T, class Reader>
+Matrix<T> load_matrix(const Reader &reader, layout order, size_t threads,
+                      const NullValues &nulls) {
+  threads = detail::thread_count(threads);
+  const size_t chunks = reader.size() < (1 << 20) ? 1 : threads * 8;
+  const auto offsets = split_points(reader, chunks);
+
+  std::vector<size_t> chunk_rows(chunks + 1, 0);
+  detail::parallel_for(chunks, threads, [&](size_t chunk) {
+    size_t rows = 0;
+    for (auto it = detail::chunk_bounds(reader, offsets, chunk); it.first != it.second; ++it.first)
+      rows += size_t((*it.first).length() > 0);
+    chunk_rows[chunk + 1] = rows;
+  });
+  for (size_t chunk = 0; chunk < chunks; ++chunk)
+    chunk_rows[chunk + 1] += chunk_rows[chunk];
+
+  Matrix<T> result(chunk_rows[chunks], reader.cols(), order);
+  std::vector<std::vector<typename Matrix<T>::Failure>> failures(chunks);
+  std::vector<std::vector<size_t>> null_cells(chunks);
+  detail::parallel_for(chunks, threads, [&](size_t chunk) {
+    size_t row = chunk_rows[chunk];
+    for (auto it = detail::chunk_bounds(reader, offsets, chunk); it.first != it.second;
+         ++it.first) {
+      const auto cells = *it.first;
+      if (cells.length() == 0)
+        continue;
+      size_t col = 0;
+      for (auto cell = cells.begin(), cells_end = cells.end();
+           col < result.cols_ && cell != cells_end; ++cell, ++col) {
+        const auto value = *cell;
+        if (value.is_null(nulls)) {
+          null_cells[chunk].push_back(result.index(row, col));
+        } else if (!value.get(result(row, col))) {
+          result(row, col) = T();
+          failures[chunk].push_back({row, col});
+        }
+      }
+      for (; col < result.cols_; ++col)
+        failures[chunk].push_back({row, col});
+      row += 1;
+    }
+  });
+
+  // Bitmap words are shared between chunks, so clear bits after the join
+  for (const auto &chunk_failures : failures) {
+    result.failures_.insert(result.failures_.end(), chunk_failures.begin(), chunk_failures.end());
+    for (const auto &failure : chunk_failures)
+      result.invalidate_(result.index(failure.row, failure.col));
+  }
+  for (const auto &chunk_nulls : null_cells) {
+    result.null_count_ += chunk_nulls.size();
+    for (const auto i : chunk_nulls)
+      result.invalidate_(i);
+  }
+  return result;
+}
+
+} // namespace csv2
@@ -0,0 +1,110 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace csv2 {
+
+namespace detail {
+
+// Number of worker threads to use; 0 means one per hardware thread
+inline size_t thread_count(size_t threads) {
+  if (threads == 0)
+    threads = std::thread::hardware_concurrency();
+  return threads == 0 ? 1 : threads;
+}
+
+// Runs task(i) for every i in [0, tasks) on up to `threads` threads
+// Tasks are handed out one at a time through a shared counter, so
+// threads that finish early pick up the remaining work. The first
+// exception thrown by a task is rethrown on the calling thread
+template <class Task> void parallel_for(size_t tasks, size_t threads, Task task) {
+  std::atomic<size_t> next{0};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto worker = [&]() {
+    for (size_t i; (i = next.fetch_add(1)) < tasks;) {
+      try {
+        task(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error)
+          error = std::current_exception();
+      }
+    }
+  };
+
+  threads = std::min(thread_count(threads), tasks);
+  std::vector<std::thread> pool;
+  for (size_t i = 1; i < threads; ++i)
+    pool.emplace_back(worker);
+  worker();
+  for (auto &thread : pool)
+    thread.join();
+  if (error)
+    std::rethrow_exception(error);
+}
+
+// Runs task(worker, i) for every i in [0, tasks) on up to `threads`
+// threads with work stealing. Every worker owns a contiguous run of task
+// indices, packed as [begin, end) into one atomic word; it takes tasks from
+// the front of its own run and, once that is empty, steals single tasks from
+// the back of the others. The first exception thrown by a task is rethrown
+// on the calling thread
+template <class Task> void stealing_for(size_t tasks, size_t threads, Task task) {
+  threads = std::max<size_t>(1, std::min(thread_count(threads), tasks));
+  std::vector<std::atomic<uint64_t>> runs(threads);
+  for (size_t worker = 0; worker < threads; ++worker)
+    runs[worker] = (uint64_t(tasks * worker / threads) << 32) | (tasks * (worker + 1) / threads);
+
+  // take a task from the front (own run) or the back (stolen) of a run
+  auto take = [&](size_t run, bool front, size_t &task_index) {
+    uint64_t current = runs[run].load();
+    for (;;) {
+      const uint64_t begin = current >> 32, end = current & 0xFFFFFFFF;
+      if (begin >= end)
+        return false;
+      const uint64_t next = front ? ((begin + 1) << 32) | end : (begin << 32) | (end - 1);
+      if (runs[run].compare_exchange_weak(current, next)) {
+        task_index = static_cast<size_t>(front ? begin : end - 1);
+        return true;
+      }
+    }
+  };
+
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto worker = [&](size_t id) {
+    for (size_t i, victim = 0; victim < threads;) {
+      if (victim == 0 ? take(id, true, i) : take((id + victim) % threads, false, i)) {
+        try {
+          task(id, i);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(error_mutex);
+          if (!error)
+            error = std::current_exception();
+        }
+        victim = 0;
+      } else {
+        ++victim;
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (size_t i = 1; i < threads; ++i)
+    pool.emplace_back(worker, i);
+  worker(0);
+  for (auto &thread : pool)
+    thread.join();
+  if (error)
+    std::rethrow_exception(error);
+}
+
+} // namespace detail
+
+} // namespace csv2
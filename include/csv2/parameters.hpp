@@ -1,5 +1,6 @@
 
 #pragma once
+#include <cstddef>
 #include <utility>
 
 namespace csv2 {
@@ -47,4 +48,25 @@ template <bool flag> struct first_row_is_header {
   constexpr static bool value = flag;
 };
 
-}
\ No newline at end of file
+// Lines starting with this character are skipped, '\0' disables comments
+template <char character> struct comment_character {
+  constexpr static char value = character;
+};
+
+// Number of leading lines to skip before the header (or the first row)
+template <size_t count> struct skip_rows {
+  constexpr static size_t value = count;
+};
+
+// Skip empty and whitespace-only lines while iterating over rows
+template <bool flag> struct ignore_empty_lines {
+  constexpr static bool value = flag;
+};
+
+// Allow line breaks inside quoted cells; rows then end at the first
+// line terminator outside quotes
+template <bool flag> struct quoted_newlines {
+  constexpr static bool value = flag;
+};
+
+}
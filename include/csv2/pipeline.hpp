@@ -0,0 +1,297 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <csv2/parallel.hpp>
+#include <csv2/reader.hpp>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace csv2 {
+
+namespace detail {
+
+// Number of record-aligned morsels for the parallel row algorithms: about
+// 256 KB each, and enough for every thread to have a few to give away
+inline size_t morsel_count(size_t size, size_t threads) {
+  return std::max<size_t>(1, std::min(size >> 12, std::max(threads * 8, size >> 18)));
+}
+
+// Calls function(row) for the rows of morsel `i` of `offsets` (from
+// split_points); the last morsel runs up to reader.end() like iteration
+template <class Reader, class Function>
+void for_each_in_morsel(const Reader &reader, const std::vector<size_t> &offsets, size_t i,
+                        Function &&function) {
+  auto rows = chunk_bounds(reader, offsets, i);
+  for (; rows.first != rows.second; ++rows.first)
+    function(*rows.first);
+}
+
+} // namespace detail
+
+// Calls fn(row) for every row of `reader` on `threads` threads (0 = one per
+// hardware thread), in no particular order. The buffer is split into
+// record-aligned morsels with split_points; every thread works through its
+// own run of morsels and then steals morsels from the others, which keeps
+// all threads busy when row widths vary. fn must be safe to call
+// concurrently
+template <class Reader, class Function>
+void parallel_for_each(const Reader &reader, Function fn, size_t threads = 0) {
+  threads = detail::thread_count(threads);
+  const auto offsets = split_points(reader, detail::morsel_count(reader.size(), threads));
+  detail::stealing_for(offsets.size() - 1, threads, [&](size_t, size_t morsel) {
+    detail::for_each_in_morsel(reader, offsets, morsel, fn);
+  });
+}
+
+// Same, with per-thread state for aggregations without locks: every thread
+// calls fn(state, row) on its own state from init(), and after the join the
+// states are combined, in thread order, with merge(result, state) into a
+// result from init(), which is returned
+template <class Reader, class Init, class Function, class Merge>
+auto parallel_for_each(const Reader &reader, Init init, Function fn, Merge merge,
+                       size_t threads = 0) -> decltype(init()) {
+  typedef decltype(init()) State;
+  threads = detail::thread_count(threads);
+  const auto offsets = split_points(reader, detail::morsel_count(reader.size(), threads));
+  const size_t workers = std::min(threads, offsets.size() - 1);
+
+  // separate allocations keep the states of different threads apart
+  std::vector<std::unique_ptr<State>> states;
+  for (size_t i = 0; i < workers; ++i)
+    states.emplace_back(new State(init()));
+  detail::stealing_for(offsets.size() - 1, workers, [&](size_t worker, size_t morsel) {
+    State &state = *states[worker];
+    detail::for_each_in_morsel(reader, offsets, morsel,
+                               [&](const typename Reader::Row &row) { fn(state, row); });
+  });
+
+  State result = init();
+  for (auto &state : states)
+    merge(result, std::move(*state));
+  return result;
+}
+
+// Ordered pipeline: converts the rows of `reader` with convert(row) on
+// `threads` worker threads (0 = one per hardware thread), and calls
+// consume(value) with the results on the calling thread, strictly in file
+// order. Workers claim record-aligned morsels and convert them into the
+// slots of a bounded ring; the calling thread consumes the slots in morsel
+// order. A worker waits while its morsel is more than 2 * threads morsels
+// ahead of the consumer (backpressure). Slots are handed over through
+// atomic sequence numbers, without locks. The first exception thrown by
+// convert or consume stops the pipeline and is rethrown
+template <class Reader, class Convert, class Consume>
+void ordered_for_each(const Reader &reader, Convert convert, Consume consume, size_t threads = 0) {
+  typedef typename Reader::Row Row;
+  typedef typename std::decay<decltype(convert(std::declval<const Row &>()))>::type Value;
+  struct Slot {
+    std::atomic<size_t> ready{0}; // morsel + 1 once converted
+    std::vector<Value> values;
+  };
+
+  threads = detail::thread_count(threads);
+  const auto offsets = split_points(reader, detail::morsel_count(reader.size(), threads));
+  const size_t morsels = offsets.size() - 1, capacity = 2 * threads;
+  std::unique_ptr<Slot[]> slots(new Slot[capacity]);
+  std::atomic<size_t> next{0}, consumed{0};
+  std::atomic<bool> stop{false};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto fail = [&]() {
+    std::lock_guard<std::mutex> lock(error_mutex);
+    if (!error)
+      error = std::current_exception();
+    stop = true;
+  };
+
+  auto worker = [&]() {
+    for (size_t morsel; !stop && (morsel = next.fetch_add(1)) < morsels;) {
+      while (morsel >= consumed.load(std::memory_order_acquire) + capacity) {
+        if (stop)
+          return;
+        std::this_thread::yield();
+      }
+      Slot &slot = slots[morsel % capacity];
+      try {
+        detail::for_each_in_morsel(reader, offsets, morsel,
+                                   [&](const Row &row) { slot.values.push_back(convert(row)); });
+      } catch (...) {
+        fail();
+        return;
+      }
+      slot.ready.store(morsel + 1, std::memory_order_release);
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (size_t i = 0; i < threads; ++i)
+    pool.emplace_back(worker);
+  try {
+    for (size_t morsel = 0; morsel < morsels; ++morsel) {
+      Slot &slot = slots[morsel % capacity];
+      while (!stop && slot.ready.load(std::memory_order_acquire) != morsel + 1)
+        std::this_thread::yield();
+      if (stop)
+        break;
+      for (auto &value : slot.values)
+        consume(std::move(value));
+      slot.values.clear();
+      consumed.store(morsel + 1, std::memory_order_release);
+    }
+  } catch (...) {
+    fail();
+  }
+  for (auto &thread : pool)
+    thread.join();
+  if (error)
+    std::rethrow_exception(error);
+}
+
+// Handle to a run of whole rows of a Reader: the rows starting in
+// [begin, end) of its buffer. Cheap to copy; the rows stay in the buffer
+struct RowSpan {
+  size_t begin;
+  size_t end;
+};
+
+// Splits the rows of `reader` into up to `count` non-empty, record-aligned
+// RowSpans (see split_points) that together cover exactly the rows of
+// reader.begin()..reader.end()
+template <class Reader> std::vector<RowSpan> row_spans(const Reader &reader, size_t count) {
+  const auto offsets = split_points(reader, count);
+  const auto last = reader.end();
+  std::vector<RowSpan> result;
+  for (size_t i = 0; i + 1 < offsets.size(); ++i) {
+    // the last span runs up to end(), after the trailing empty row
+    const size_t end = i + 2 == offsets.size() ? reader.size() + 1 : offsets[i + 1];
+    auto first = i == 0 ? reader.begin() : detail::split_iterator(reader, offsets[i]);
+    if (offsets[i] < end && first != last)
+      result.push_back(RowSpan{offsets[i], end});
+  }
+  return result;
+}
+
+// Calls fn(row) for the rows in `span`
+template <class Reader, class Function>
+void for_each_row(const Reader &reader, RowSpan span, Function &&fn) {
+  auto last = detail::split_iterator(reader, span.end);
+  for (auto it = detail::split_iterator(reader, span.begin); it != last; ++it)
+    fn(*it);
+}
+
+// Bounded lock-free multi-producer multi-consumer queue, for handing
+// RowSpans (or other small handles) from producer to consumer threads:
+//
+//   BoundedQueue<RowSpan> queue(1024);
+//   producers: for (auto span : row_spans(csv, n)) queue.push(span);
+//              ... and queue.close() once all producers are done
+//   consumers: for (RowSpan span; queue.pop(span);)
+//                for_each_row(csv, span, [](const Row &row) { ... });
+//
+// Every slot carries a sequence number that tells whether it is free for
+// the push, or filled for the pop, at a given position; producers and
+// consumers claim positions with a compare-and-swap on their own counter
+// and never wait on a lock. The capacity is rounded up to a power of two
+template <class T> class BoundedQueue {
+  struct Slot {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;
+  char padding0_[64];
+  std::atomic<size_t> enqueue_{0}; // next position to push
+  char padding1_[64];
+  std::atomic<size_t> dequeue_{0}; // next position to pop
+  char padding2_[64];
+  std::atomic<bool> closed_{false};
+
+public:
+  explicit BoundedQueue(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity)
+      size *= 2;
+    slots_.reset(new Slot[size]);
+    mask_ = size - 1;
+    for (size_t i = 0; i < size; ++i)
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  BoundedQueue(const BoundedQueue &) = delete;
+  BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+  size_t capacity() const { return mask_ + 1; }
+
+  // Pushes `value` unless the queue is full
+  bool try_push(const T &value) {
+    size_t position = enqueue_.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+      slot = &slots_[position & mask_];
+      const intptr_t difference =
+          intptr_t(slot->sequence.load(std::memory_order_acquire)) - intptr_t(position);
+      if (difference == 0) {
+        if (enqueue_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+          break;
+      } else if (difference < 0) {
+        return false; // the slot still holds the value pushed a lap ago
+      } else {
+        position = enqueue_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->value = value;
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Pops the oldest value into `value` unless the queue is empty
+  bool try_pop(T &value) {
+    size_t position = dequeue_.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+      slot = &slots_[position & mask_];
+      const intptr_t difference =
+          intptr_t(slot->sequence.load(std::memory_order_acquire)) - intptr_t(position + 1);
+      if (difference == 0) {
+        if (dequeue_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+          break;
+      } else if (difference < 0) {
+        return false; // not pushed yet
+      } else {
+        position = dequeue_.load(std::memory_order_relaxed);
+      }
+    }
+    value = std::move(slot->value);
+    slot->sequence.store(position + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Pushes `value`, yielding while the queue is full
+  void push(const T &value) {
+    while (!try_push(value))
+      std::this_thread::yield();
+  }
+
+  // No more pushes; pop() returns false once the queue is drained. Call
+  // after all producers are done
+  void close() { closed_.store(true, std::memory_order_release); }
+
+  // Pops the oldest value, yielding while the queue is empty; false once
+  // the queue is closed and empty
+  bool pop(T &value) {
+    for (;;) {
+      if (try_pop(value))
+        return true;
+      if (closed_.load(std::memory_order_acquire))
+        return try_pop(value);
+      std::this_thread::yield();
+    }
+  }
+};
+
+} // namespace csv2
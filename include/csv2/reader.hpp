@@ -1,22 +1,54 @@
 
 #pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <cstring>
 #if __has_include("sys/mman.h") || __has_include(<sys/mman.h>) || __has_include("windows.h") || __has_include(<windows.h>)
 #define __CSV2_HAS_MMAN_H__ 1
 #include <csv2/mio.hpp>
 #endif
+#include <csv2/convert.hpp>
 #include <csv2/parameters.hpp>
+#include <csv2/scan.hpp>
+#include <fstream>
 #include <istream>
+#include <random>
+#include <stdexcept>
 #include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 #if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
 	#include <string_view>
 #endif
 
 namespace csv2 {
 
+// Result of Reader::estimate_rows(); [lower, upper] is a 95% confidence
+// interval around `rows`, and collapses onto it if the count is exact
+struct RowEstimate {
+  size_t rows;
+  size_t lower;
+  size_t upper;
+  bool exact;
+};
+
+// How Reader::filter compares a cell with the given value
+enum class match { equals, prefix, contains };
+
+template <class Reader> std::vector<size_t> split_points(const Reader &reader, size_t count);
+template <class Reader>
+std::vector<typename Reader::Row> sample(const Reader &reader, size_t count, uint64_t seed);
+
 template <class delimiter = delimiter<','>, class quote_character = quote_character<'"'>,
           class first_row_is_header = first_row_is_header<true>,
-          class trim_policy = trim_policy::trim_whitespace>
+          class trim_policy = trim_policy::trim_whitespace,
+          class comment_character = comment_character<'\0'>, class skip_rows = skip_rows<0>,
+          class ignore_empty_lines = ignore_empty_lines<false>,
+          class quoted_newlines = quoted_newlines<false>>
 class Reader {
   #if __CSV2_HAS_MMAN_H__
   mio::mmap_source mmap_;          // mmap source
@@ -25,18 +57,152 @@ class Reader {
   size_t buffer_size_{0};          // mapped length of buffer
   size_t header_start_{0};         // start index of header (cache)
   size_t header_end_{0};           // end index of header (cache)
+  size_t rows_start_{0};           // start index of the row after the header (cache)
+  size_t first_row_{0};            // start index of the first row visited by begin()
+  const char *header_buffer_{nullptr}; // buffer holding the header, buffer_ unless
+                                       // a chunk of a file is mapped
+  char newline_{'\n'};             // line terminator, '\r' for CR-only files
+  bool crlf_{false};               // do lines end with "\r\n"?
+  size_t limit_{0};                // maximum number of rows, 0 = all
+  size_t truncated_{0};            // after the limit_-th row's terminator, 0 = not truncated
+  #if __CSV2_HAS_MMAN_H__
+  bool complete_rows_{false};      // end mmap'ed buffers at the last line terminator?
+  std::string path_;               // mmap'ed file, for follow()
+  mio::mmap_source follow_mmap_;   // region appended since the last follow()
+  size_t followed_{0};             // file offset up to which rows were delivered
+  mio::mmap_source header_mmap_;   // start of the file, if a chunk is mapped
+  #endif
 
 public:
   #if __CSV2_HAS_MMAN_H__
   // Use this if you'd like to mmap the CSV file
+  // With limit(n), only the first pages of the file, up to the end of the
+  // n-th row, are mapped
   template <typename StringType> bool mmap(StringType &&filename) {
-    mmap_ = mio::mmap_source(filename);
-    if (!mmap_.is_open() || !mmap_.is_mapped())
+    path_ = filename;
+    if (limit_ > 0) {
+      if (!mmap_head_(filename))
+        return false;
+    } else {
+      mmap_ = mio::mmap_source(filename);
+      if (!mmap_.is_open() || !mmap_.is_mapped())
+        return false;
+      buffer_ = mmap_.data();
+      buffer_size_ = mmap_.mapped_length();
+      index_();
+    }
+    followed_ = complete_end_();
+    if (complete_rows_)
+      buffer_size_ = std::min(buffer_size_, followed_);
+    return true;
+  }
+
+  // Use this to mmap only the bytes [offset, offset + length) of the file,
+  // e.g., one of the chunks from csv2::split_points; `offset` must be a row
+  // boundary. The header is read from the start of the file, mapping only
+  // the pages up to its end. Row offsets are relative to `offset`
+  template <typename StringType> bool mmap(StringType &&filename, size_t offset, size_t length) {
+    path_ = filename;
+    const size_t file_size = file_size_(filename);
+    if (offset >= file_size)
+      return false;
+    length = std::min(length, file_size - offset);
+    std::error_code error;
+    if (offset > 0) {
+      // the header, from a growing prefix of the file
+      for (size_t prefix = size_t(4) << 10;; prefix *= 2) {
+        prefix = std::min(prefix, file_size);
+        mmap_.map(filename, 0, prefix, error);
+        if (error)
+          return false;
+        buffer_ = mmap_.data();
+        buffer_size_ = mmap_.mapped_length();
+        index_();
+        if (rows_start_ <= buffer_size_ || prefix == file_size)
+          break;
+      }
+      header_mmap_ = std::move(mmap_);
+    }
+    mmap_.map(filename, offset, length, error);
+    if (error)
       return false;
     buffer_ = mmap_.data();
-    buffer_size_ = mmap_.mapped_length();
+    buffer_size_ = mmap_.length();
+    if (offset > 0)
+      first_row_ = 0;
+    else
+      index_();
+    truncate_();
+    followed_ = complete_end_();
+    if (complete_rows_)
+      buffer_size_ = std::min(buffer_size_, followed_);
+    followed_ += offset;
     return true;
   }
+
+  // Follow mode (tail -f): calls `callback(row)` for each complete row
+  // appended to the mmap'ed file since mmap() or the last follow() call, and
+  // returns the number of rows delivered. Only the new region of the file is
+  // mapped; a row without its line terminator yet is delivered by a later
+  // call, once complete; so is the header, if its line was incomplete at
+  // mmap(). Use complete_rows(true) so that iteration does not also yield
+  // such a partial last line. Delivered rows are valid until the next call;
+  // their offset() is relative to the new region, which starts at the file
+  // offset followed() returned before the call. See FileWatcher
+  // (csv2/follow.hpp) to wait for appends
+  template <typename Function> size_t follow(Function &&callback) {
+    const size_t size = file_size_(path_);
+    if (size <= followed_)
+      return 0;
+    std::error_code error;
+    if (first_row_is_header::value && rows_start_ > buffer_size_) {
+      // the header line was incomplete when mapped: index it again, the
+      // rows start after it
+      mmap_.map(path_, error);
+      if (error)
+        return 0;
+      buffer_ = mmap_.data();
+      buffer_size_ = mmap_.mapped_length();
+      index_();
+      if (rows_start_ > buffer_size_)
+        return 0;
+      // the rows are delivered below, not by iteration
+      followed_ = buffer_size_ = rows_start_;
+      if (size <= followed_)
+        return 0;
+    }
+    follow_mmap_.map(path_, followed_, size - followed_, error);
+    if (error)
+      return 0;
+
+    const char *region = follow_mmap_.data();
+    const size_t length = follow_mmap_.length();
+    size_t result{0}, start{0};
+    for (size_t end; (end = row_end_(region, length, newline_, start)) < length; start = end + 1) {
+      if (comment_line_(region + start, region + end) or
+          (ignore_empty_lines::value and blank_line_(region + start, region + end)))
+        continue;
+      callback(row_(region, start, end));
+      ++result;
+    }
+    followed_ += start;
+    return result;
+  }
+  #endif
+
+  // Limits the following mmap() and parse() calls to the first `rows` rows
+  // (after the header), e.g., to preview a large file; 0 removes the limit
+  void limit(size_t rows) { limit_ = rows; }
+
+  #if __CSV2_HAS_MMAN_H__
+  // Ends the buffers of the following mmap() calls at the last line
+  // terminator, leaving out an incomplete last line, e.g., for a file that
+  // is still being written: iteration then ends where follow() picks up
+  void complete_rows(bool flag) { complete_rows_ = flag; }
+
+  // File offset up to which rows were delivered, where the next follow()
+  // call picks up
+  size_t followed() const { return followed_; }
   #endif
 
   // Use this if you have the CSV contents
@@ -44,6 +210,8 @@ public:
   template <typename StringType> bool parse(StringType &&contents) {
     buffer_ = std::forward<StringType>(contents).c_str();
     buffer_size_ = contents.size();
+    index_();
+    truncate_();
     return buffer_size_ > 0;
   }
 
@@ -54,6 +222,8 @@ public:
   bool parse_view(std::string_view sv) {
     buffer_ = sv.data();
     buffer_size_ = sv.size();
+    index_();
+    truncate_();
     return buffer_size_ > 0;
   }
 #endif
@@ -68,6 +238,7 @@ public:
     size_t start_{0};             // Start index of cell content
     size_t end_{0};               // End index of cell content
     bool escaped_{false};         // Does the cell have escaped content?
+    friend class Reader;
     friend class Row;
     friend class CellIterator;
 
@@ -106,18 +277,65 @@ public:
         }
       }
     }
+
+    // True if the (trimmed, unquoted) cell contents are one of the null tokens
+    bool is_null(const NullValues &nulls) const {
+      const auto span = unquoted_(*this);
+      return nulls.contains(buffer_ + span.first, buffer_ + span.second);
+    }
+
+    // Converts the trimmed cell contents, without enclosing quotes, with
+    // csv2::convert<T>, so "1" and 1 are the same integer
+    // Returns false if the contents are not a valid T
+    template <typename T> bool get(T &result) const {
+      const auto span = unquoted_(*this);
+      return get_(buffer_ + span.first, buffer_ + span.second, result);
+    }
+
+    // Same as above, but throws std::invalid_argument on failure
+    template <typename T> T get() const {
+      T result{};
+      if (!get(result)) {
+        std::string value;
+        read_raw_value(value);
+        throw std::invalid_argument("csv2: cannot convert cell value \"" + value + "\"");
+      }
+      return result;
+    }
+
+  private:
+    template <typename T> bool get_(const char *first, const char *last, T &result) const {
+      return convert<T>::parse(first, last, result);
+    }
+
+    // Strings unescape doubled quote characters
+    bool get_(const char *first, const char *last, std::string &result) const {
+      const char quote = quote_character::value;
+      result.clear();
+      result.reserve(last - first);
+      for (; first != last; ++first) {
+        result.push_back(*first);
+        if (*first == quote && first + 1 != last && first[1] == quote)
+          ++first;
+      }
+      return true;
+    }
   };
 
   class Row {
-    const char *buffer_{nullptr}; // Pointer to memory-mapped buffer
-    size_t start_{0};             // Start index of row content
-    size_t end_{0};               // End index of row content
+    const Reader *reader_{nullptr}; // Reader that produced this row
+    const char *buffer_{nullptr};   // Pointer to memory-mapped buffer
+    size_t start_{0};               // Start index of row content
+    size_t end_{0};                 // End index of row content
     friend class RowIterator;
     friend class Reader;
 
   public:
     // address of row
-    const char *address() const { return buffer_; }
+    const char *address() const { return buffer_ + start_; }
+    // byte offset of the row in the buffer, e.g., a checkpoint to resume
+    // from with Reader::begin(offset)
+    size_t offset() const { return start_; }
 	// returns the char length of the row
 	size_t length() const { return end_ - start_; }
 
@@ -188,119 +406,1127 @@ public:
 
     CellIterator begin() const { return CellIterator(buffer_, end_ - start_, start_, end_); }
     CellIterator end() const { return CellIterator(buffer_, end_ - start_, end_, end_); }
+
+    // Returns the cell at column `index`, or an empty cell
+    // if the row has fewer columns
+    Cell get(size_t index) const {
+      for (auto it = begin(), last = end(); it != last; ++it) {
+        const Cell cell = *it;
+        if (index-- == 0)
+          return cell;
+      }
+      return Cell();
+    }
+
+    // Other integer types, so that get(0) does not also match get(const char *)
+    template <typename Index>
+    typename std::enable_if<std::is_integral<Index>::value, Cell>::type get(Index index) const {
+      return get(static_cast<size_t>(index));
+    }
+
+    // Returns the cell under the header column `name`, see
+    // Reader::column_index
+    Cell get(const char *name) const { return get_(reader_->column_index(name)); }
+    Cell get(const std::string &name) const { return get_(reader_->column_index(name)); }
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+    Cell get(std::string_view name) const { return get_(reader_->column_index(name)); }
+#endif
+
+    // Returns the cells at the given (compile-time) columns; tokenization
+    // stops after the last selected column
+    template <size_t... columns> std::array<Cell, sizeof...(columns)> select() const {
+      const size_t indices[] = {columns...};
+      std::array<Cell, sizeof...(columns)> result;
+      size_t column = 0;
+      for (auto it = begin(), last = end();
+           it != last && column <= last_column_(columns...); ++it, ++column) {
+        const Cell cell = *it;
+        for (size_t i = 0; i < sizeof...(columns); ++i)
+          if (indices[i] == column)
+            result[i] = cell;
+      }
+      return result;
+    }
+
+    // Parses the leading cells of the row into a tuple, in one pass,
+    // e.g., row.as<int64_t, double, std::string>()
+    // Throws std::invalid_argument if a cell cannot be converted
+    template <class... Types> std::tuple<Types...> as() const {
+      std::tuple<Types...> result;
+      auto it = begin();
+      auto last = end();
+      read_tuple_<0>(it, last, result);
+      return result;
+    }
+
+    // Parses the leading cells of the row into the given members
+    // of an aggregate, e.g., row.into<Trade>(&Trade::id, &Trade::price)
+    // Throws std::invalid_argument if a cell cannot be converted
+    template <class T, class... Fields> T into(Fields T::*... fields) const {
+      return into_<T>(std::make_tuple(fields...));
+    }
+
+  private:
+    friend class Reader;
+
+    Cell get_(size_t index) const { return index == std::string::npos ? Cell() : get(index); }
+
+    static Cell next_cell_(CellIterator &it, CellIterator &last) {
+      if (!(it != last))
+        return Cell();
+      const Cell cell = *it;
+      ++it;
+      return cell;
+    }
+
+    template <size_t I, class Tuple>
+    typename std::enable_if<(I == std::tuple_size<Tuple>::value)>::type
+    read_tuple_(CellIterator &, CellIterator &, Tuple &) const {}
+
+    template <size_t I, class Tuple>
+    typename std::enable_if<(I < std::tuple_size<Tuple>::value)>::type
+    read_tuple_(CellIterator &it, CellIterator &last, Tuple &result) const {
+      std::get<I>(result) =
+          next_cell_(it, last).template get<typename std::tuple_element<I, Tuple>::type>();
+      read_tuple_<I + 1>(it, last, result);
+    }
+
+    template <class T, class Tuple> T into_(const Tuple &fields) const {
+      T result{};
+      auto it = begin();
+      auto last = end();
+      read_fields_<0>(it, last, result, fields);
+      return result;
+    }
+
+    template <size_t I, class T, class Tuple>
+    typename std::enable_if<(I == std::tuple_size<Tuple>::value)>::type
+    read_fields_(CellIterator &, CellIterator &, T &, const Tuple &) const {}
+
+    template <size_t I, class T, class Tuple>
+    typename std::enable_if<(I < std::tuple_size<Tuple>::value)>::type
+    read_fields_(CellIterator &it, CellIterator &last, T &result, const Tuple &fields) const {
+      const auto field = std::get<I>(fields);
+      typedef typename std::remove_reference<decltype(result.*field)>::type Field;
+      result.*field = next_cell_(it, last).template get<Field>();
+      read_fields_<I + 1>(it, last, result, fields);
+    }
   };
 
   class RowIterator {
     friend class Reader;
+    const Reader *reader_;
     const char *buffer_;
     size_t buffer_size_;
     size_t start_;
     size_t end_;
+    char newline_;
+    bool crlf_;
 
   public:
-    RowIterator(const char *buffer, size_t buffer_size, size_t start)
-        : buffer_(buffer), buffer_size_(buffer_size), start_(start), end_(start_) {}
+    RowIterator(const char *buffer, size_t buffer_size, size_t start,
+                const Reader *reader = nullptr)
+        : reader_(reader), buffer_(buffer), buffer_size_(buffer_size), start_(start),
+          end_(start_), newline_(reader ? reader->newline_ : '\n'),
+          crlf_(reader ? reader->crlf_ : false) {
+      skip_();
+    }
 
     RowIterator &operator++() {
       start_ = end_ + 1;
+      skip_();
       end_ = start_;
       return *this;
     }
 
     Row operator*() {
       Row result;
+      result.reader_ = reader_;
       result.buffer_ = buffer_;
       result.start_ = start_;
       result.end_ = end_;
 
-      if (const char *ptr =
-              static_cast<const char *>(memchr(&buffer_[start_], '\n', (buffer_size_ - start_)))) {
-        end_ = start_ + (ptr - &buffer_[start_]);
-        result.end_ = end_;
+      end_ = row_end_(buffer_, buffer_size_, newline_, start_);
+      result.end_ = end_;
+      if (end_ < buffer_size_)
         start_ = end_ + 1;
-      } else {
-        // last row
-        end_ = buffer_size_;
-        result.end_ = end_;
-      }
+      // drop the '\r' of a "\r\n" line ending
+      if (crlf_ && result.end_ > result.start_ && buffer_[result.end_ - 1] == '\r')
+        result.end_ -= 1;
       return result;
     }
 
     bool operator!=(const RowIterator &rhs) { return start_ != rhs.start_; }
+
+  private:
+    // Moves past skipped lines, so that the iterator always rests
+    // on a row that will be returned
+    void skip_() { start_ = skip_lines_(buffer_, buffer_size_, newline_, start_); }
   };
 
   RowIterator begin() const {
     if (buffer_size_ == 0)
       return end();
-    if (first_row_is_header::value) {
-      const auto header_indices = header_indices_();
-      return RowIterator(buffer_, buffer_size_, header_indices.second  > 0 ? header_indices.second + 1 : 0);
-    } else {
-      return RowIterator(buffer_, buffer_size_, 0);
+    return RowIterator(buffer_, buffer_size_, first_row_, this);
+  }
+
+  RowIterator end() const { return RowIterator(buffer_, buffer_size_, buffer_size_ + 1, this); }
+
+  // Iterator starting at the first row boundary at or after `offset`
+  // Iterating from begin(a) to begin(b) visits the rows starting in
+  // [a, b), which makes it easy to split the buffer into chunks, and
+  // begin(row.offset()) resumes iteration at a checkpointed row
+  // With quoted_newlines, whether `offset` lies inside a quoted cell is
+  // derived from the parity of the quote characters after it (the buffer
+  // must end outside quotes), so the cost is proportional to the remaining
+  // bytes
+  RowIterator begin(size_t offset) const {
+    const RowIterator first = begin();
+    if (offset <= first.start_)
+      return first;
+    if (offset > buffer_size_)
+      return end();
+    if (quoted_newlines::value)
+      return RowIterator(buffer_, buffer_size_, resync_(offset), this);
+    if (buffer_[offset - 1] == newline_)
+      return RowIterator(buffer_, buffer_size_, offset, this);
+    if (const char *ptr =
+            static_cast<const char *>(memchr(&buffer_[offset], newline_, buffer_size_ - offset)))
+      return RowIterator(buffer_, buffer_size_, (ptr - buffer_) + 1, this);
+    return end();
+  }
+
+  // Raw access to the mapped/parsed buffer
+  const char *data() const { return buffer_; }
+  size_t size() const { return buffer_size_; }
+
+  // Range over the rows that yields function(row) for every row
+  template <class Function> class RowRange {
+    const Reader *reader_;
+    Function function_;
+
+  public:
+    class iterator {
+      RowIterator row_;
+      Function function_;
+
+    public:
+      iterator(RowIterator row, Function function) : row_(row), function_(function) {}
+
+      iterator &operator++() {
+        ++row_;
+        return *this;
+      }
+
+      auto operator*() -> decltype(std::declval<Function &>()(std::declval<Row>())) {
+        return function_(*row_);
+      }
+
+      bool operator!=(const iterator &rhs) { return row_ != rhs.row_; }
+    };
+
+    RowRange(const Reader *reader, Function function) : reader_(reader), function_(function) {}
+    iterator begin() const { return iterator(reader_->begin(), function_); }
+    iterator end() const { return iterator(reader_->end(), function_); }
+  };
+
+  template <size_t... columns> struct ColumnSelector {
+    std::array<Cell, sizeof...(columns)> operator()(const Row &row) const {
+      return row.template select<columns...>();
     }
+  };
+
+  template <class... Types> struct TupleParser {
+    std::tuple<Types...> operator()(const Row &row) const {
+      return row.template as<Types...>();
+    }
+  };
+
+  template <class T, class... Fields> struct FieldParser {
+    std::tuple<Fields T::*...> fields;
+    T operator()(const Row &row) const { return row.template into_<T>(fields); }
+  };
+
+  // Iterate over rows as std::array<Cell, N> of the given columns,
+  // e.g., for (auto cells : csv.select<0, 3, 5>()) { ... }
+  template <size_t... columns> RowRange<ColumnSelector<columns...>> select() const {
+    static_assert(sizeof...(columns) > 0, "select requires at least one column");
+    return RowRange<ColumnSelector<columns...>>(this, ColumnSelector<columns...>());
+  }
+
+  // Iterate over rows as std::tuple<Types...>, see Row::as
+  template <class... Types> RowRange<TupleParser<Types...>> as() const {
+    return RowRange<TupleParser<Types...>>(this, TupleParser<Types...>());
+  }
+
+  // Iterate over rows as aggregates of type T, see Row::into
+  template <class T, class... Fields>
+  RowRange<FieldParser<T, Fields...>> into(Fields T::*... fields) const {
+    return RowRange<FieldParser<T, Fields...>>(this, FieldParser<T, Fields...>{
+                                                         std::make_tuple(fields...)});
   }
 
-  RowIterator end() const { return RowIterator(buffer_, buffer_size_, buffer_size_ + 1); }
+  /**
+   * @returns The last `n` rows visited by begin()..end(), in order. The
+   * buffer is scanned backwards from its end, so only the bytes of those
+   * rows are read. With quoted_newlines, a line terminator ends a row if an
+   * even number of quote characters follows it (the buffer must end outside
+   * quotes). Unlike iteration, the empty row after a trailing line
+   * terminator is not returned, so tail(1) is the last line of a log
+  */
+  std::vector<Row> tail(size_t n) const {
+    std::vector<Row> result;
+    if (!buffer_ || n == 0)
+      return result;
+    const size_t first = begin().start_;
+    if (first > buffer_size_)
+      return result;
+
+    bool odd = false; // odd number of quote characters after `position`?
+    for (size_t position = buffer_size_, end = buffer_size_; result.size() < n;) {
+      const char *found = detail::find_last(buffer_ + first, buffer_ + position, newline_);
+      const size_t start = found ? found - buffer_ + 1 : first;
+      if (quoted_newlines::value)
+        odd = odd != odd_quotes_(buffer_ + start, buffer_ + position);
+      if (found && odd) {
+        // inside a quoted cell, keep looking for the start of the row
+        position = start - 1;
+        continue;
+      }
+      // skips the empty row after a trailing line terminator
+      if (start < buffer_size_ and not comment_line_(buffer_ + start, buffer_ + end) and
+          (not ignore_empty_lines::value or not blank_line_(buffer_ + start, buffer_ + end)))
+        result.push_back(row_(start, end));
+      if (not found)
+        break;
+      position = end = start - 1;
+    }
+    std::reverse(result.begin(), result.end());
+    return result;
+  }
+
+  // Block of consecutive rows, tokenized in bulk into a structure of
+  // arrays: the offsets of every row and the spans of their cells, so
+  // that consumers can run tight loops over whole blocks, see batches()
+  class RowBatch {
+    friend class Reader;
+    const Reader *reader_{nullptr};
+    const char *buffer_{nullptr};
+    std::vector<size_t> row_starts_; // start offset of row i
+    std::vector<size_t> row_ends_;   // end offset of row i
+    std::vector<size_t> cell_index_; // cells of row i: [cell_index_[i], cell_index_[i + 1])
+    std::vector<size_t> cell_starts_;
+    std::vector<size_t> cell_ends_;
+    std::vector<char> cell_escaped_;
+
+    void clear_() {
+      row_starts_.clear();
+      row_ends_.clear();
+      cell_index_.assign(1, 0);
+      cell_starts_.clear();
+      cell_ends_.clear();
+      cell_escaped_.clear();
+    }
+
+    void push_(const Row &row) {
+      row_starts_.push_back(row.start_);
+      row_ends_.push_back(row.end_);
+      for (auto it = row.begin(), last = row.end(); it != last; ++it) {
+        const Cell cell = *it;
+        cell_starts_.push_back(cell.start_);
+        cell_ends_.push_back(cell.end_);
+        cell_escaped_.push_back(cell.escaped_);
+      }
+      cell_index_.push_back(cell_starts_.size());
+    }
+
+  public:
+    // Number of rows in the batch
+    size_t size() const { return row_starts_.size(); }
+
+    Row row(size_t i) const { return reader_->row_(buffer_, row_starts_[i], row_ends_[i]); }
+
+    // Number of cells in row i
+    size_t cells(size_t i) const { return cell_index_[i + 1] - cell_index_[i]; }
+
+    // Cell `column` of row i (empty if the row has fewer cells)
+    Cell cell(size_t i, size_t column) const {
+      Cell result;
+      if (column >= cells(i))
+        return result;
+      const size_t index = cell_index_[i] + column;
+      result.buffer_ = buffer_;
+      result.start_ = cell_starts_[index];
+      result.end_ = cell_ends_[index];
+      result.escaped_ = cell_escaped_[index] != 0;
+      return result;
+    }
+
+    // Raw arrays: row offsets, the first cell of each row (size() + 1
+    // entries), and the (untrimmed) cell spans in the buffer
+    const char *data() const { return buffer_; }
+    const std::vector<size_t> &row_starts() const { return row_starts_; }
+    const std::vector<size_t> &row_ends() const { return row_ends_; }
+    const std::vector<size_t> &cell_index() const { return cell_index_; }
+    const std::vector<size_t> &cell_starts() const { return cell_starts_; }
+    const std::vector<size_t> &cell_ends() const { return cell_ends_; }
+  };
+
+  // Range over the rows in blocks of up to `rows` rows, see batches()
+  class BatchRange {
+    const Reader *reader_;
+    size_t rows_;
+
+  public:
+    class iterator {
+      RowIterator row_;
+      RowIterator end_;
+      size_t rows_;
+      RowBatch batch_; // reused for every block
+      size_t start_{0}; // offset of the first row of the block
+
+      void fill_() {
+        start_ = row_.start_;
+        batch_.clear_();
+        for (; batch_.size() < rows_ && row_ != end_; ++row_)
+          batch_.push_(*row_);
+      }
+
+    public:
+      iterator(const Reader *reader, RowIterator row, size_t rows)
+          : row_(row), end_(reader->end()), rows_(rows) {
+        batch_.reader_ = reader;
+        batch_.buffer_ = reader->buffer_;
+        fill_();
+      }
+
+      iterator &operator++() {
+        fill_();
+        return *this;
+      }
+
+      const RowBatch &operator*() const { return batch_; }
+
+      // iterators compare equal at the same block, or once the rows are
+      // exhausted
+      bool operator!=(const iterator &rhs) const {
+        const bool exhausted = batch_.size() == 0;
+        return exhausted != (rhs.batch_.size() == 0) || (!exhausted && start_ != rhs.start_);
+      }
+    };
+
+    BatchRange(const Reader *reader, size_t rows) : reader_(reader), rows_(rows) {}
+    iterator begin() const { return iterator(reader_, reader_->begin(), rows_); }
+    iterator end() const { return iterator(reader_, reader_->end(), rows_); }
+  };
+
+  // Iterate over the rows in batches of up to `rows` rows, e.g.,
+  // for (const auto &batch : csv.batches(1024)) { ... batch.cell(i, 2) ... }
+  // The batch is reused, it is valid until the iterator is incremented
+  BatchRange batches(size_t rows = 1024) const {
+    return BatchRange(this, std::max<size_t>(rows, 1));
+  }
+
+  // Iterates over the rows whose cell in a column matches a value, see filter()
+  class FilterRange {
+    const Reader *reader_;
+    size_t column_;
+    match kind_;
+    std::string value_;
+
+  public:
+    class iterator {
+      const FilterRange *range_;
+      size_t start_;
+      size_t end_;
+
+      // Moves to the first matching row at or after the row starting at `from`
+      void advance_(size_t from) {
+        const Reader &reader = *range_->reader_;
+        const std::string &value = range_->value_;
+        const char *buffer = reader.buffer_;
+        const size_t size = reader.buffer_size_;
+        while (from < size) {
+          // candidate: the first row (after `from`) that contains the value
+          const char *found = detail::find(buffer + from, buffer + size, value.data(), value.size());
+          if (not found)
+            break;
+          size_t start = found - buffer;
+          if (quoted_newlines::value) {
+            // rows can span lines, walk forward to the row containing the value
+            for (size_t end; (end = row_end_(buffer, size, reader.newline_, from)) < start;)
+              from = end + 1;
+            start = from;
+          } else {
+            while (start > from && buffer[start - 1] != reader.newline_)
+              --start;
+          }
+          const size_t end = row_end_(buffer, size, reader.newline_, start);
+          if (matches_(start, end)) {
+            start_ = start;
+            end_ = end;
+            return;
+          }
+          from = end + 1;
+        }
+        start_ = end_ = size + 1;
+      }
+
+      // Tokenizes the row [start, end) and compares the cell in the column
+      bool matches_(size_t start, size_t end) const {
+        const Reader &reader = *range_->reader_;
+        const char *first = reader.buffer_ + start, *last = reader.buffer_ + end;
+        if (comment_line_(first, last) or (ignore_empty_lines::value and reader.blank_line_(first, last)))
+          return false;
+        const Row row = reader.row_(start, end);
+        const Cell cell = row.get(range_->column_);
+        if (row.length() == 0 or cell.buffer_ == nullptr)
+          return false;
+
+        const auto span = reader.unquoted_(cell);
+        const char *text = cell.buffer_ + span.first;
+        const size_t length = span.second - span.first;
+        const std::string &value = range_->value_;
+        switch (range_->kind_) {
+        case match::equals:
+          return length == value.size() and memcmp(text, value.data(), length) == 0;
+        case match::prefix:
+          return length >= value.size() and memcmp(text, value.data(), value.size()) == 0;
+        default:
+          return detail::find(text, text + length, value.data(), value.size()) != nullptr;
+        }
+      }
+
+    public:
+      iterator(const FilterRange *range, size_t start) : range_(range), start_(start), end_(start) {
+        if (start_ <= range_->reader_->buffer_size_)
+          advance_(start_);
+      }
+
+      iterator &operator++() {
+        advance_(end_ + 1);
+        return *this;
+      }
+
+      Row operator*() const { return range_->reader_->row_(start_, end_); }
+
+      bool operator!=(const iterator &rhs) { return start_ != rhs.start_; }
+    };
+
+    FilterRange(const Reader *reader, size_t column, match kind, std::string value)
+        : reader_(reader), column_(column), kind_(kind), value_(std::move(value)) {}
+    iterator begin() const {
+      return iterator(this, reader_->buffer_ ? reader_->begin().start_ : 0);
+    }
+    iterator end() const { return iterator(this, reader_->buffer_size_ + 1); }
+  };
+
+  // Iterate over the rows whose cell in `column` equals, starts with or
+  // contains `value` (after trimming and removing enclosing quotes), e.g.,
+  // for (auto row : csv.filter(2, csv2::match::equals, "NYSE")) { ... }
+  // Candidate rows are located with a substring search over the buffer and
+  // only those rows are tokenized
+  FilterRange filter(size_t column, match kind, std::string value) const {
+    return FilterRange(this, column, kind, std::move(value));
+  }
 
 private:
-  std::pair<size_t, size_t> header_indices_() const {
-    size_t start = 0, end = 0;
+  template <class R> friend std::vector<size_t> split_points(const R &reader, size_t count);
+  template <class R>
+  friend std::vector<typename R::Row> sample(const R &reader, size_t count, uint64_t seed);
 
-    if (const char *ptr =
-            static_cast<const char *>(memchr(&buffer_[start], '\n', (buffer_size_ - start)))) {
-      end = start + (ptr - &buffer_[start]);
+  constexpr static size_t last_column_() { return 0; }
+
+  template <class... Tail> constexpr static size_t last_column_(size_t head, Tail... tail) {
+    return head > last_column_(tail...) ? head : last_column_(tail...);
+  }
+
+  std::vector<Cell> header_cells_;   // cells of the header row (cache)
+  std::vector<size_t> column_slots_; // open-addressing table of column index + 1
+
+  // Hashes a column name with FNV-1a
+  static size_t hash_name_(const char *name, size_t length) {
+    size_t result = static_cast<size_t>(14695981039346656037ULL);
+    for (size_t i = 0; i < length; ++i) {
+      result ^= static_cast<unsigned char>(name[i]);
+      result *= static_cast<size_t>(1099511628211ULL);
+    }
+    return result;
+  }
+
+  // Trimmed cell contents without enclosing quotes, in cell.buffer_
+  static std::pair<size_t, size_t> unquoted_(const Cell &cell) {
+    auto span = trim_policy::trim(cell.buffer_, cell.start_, cell.end_);
+    if (span.second - span.first >= 2 && cell.buffer_[span.first] == quote_character::value &&
+        cell.buffer_[span.second - 1] == quote_character::value) {
+      span.first += 1;
+      span.second -= 1;
     }
-    return {start, end};
+    return span;
   }
 
-public:
+  // Detects the line ending: "\r\n" if the first '\n' follows a '\r', and
+  // a lone '\r' only if the buffer has no '\n' at all, so that a stray '\r'
+  // inside a line does not change how the file is split
+  void detect_line_ending_() {
+    const char *lf = static_cast<const char *>(memchr(buffer_, '\n', buffer_size_));
+    newline_ = !lf && memchr(buffer_, '\r', buffer_size_) ? '\r' : '\n';
+    crlf_ = lf && lf > buffer_ && lf[-1] == '\r';
+  }
 
-  Row header() const {
-    size_t start = 0, end = 0;
+  // Detects the line ending, tokenizes the header once and builds
+  // the column name lookup table
+  void index_() {
+    header_start_ = 0;
+    header_end_ = buffer_size_;
+    rows_start_ = buffer_size_ + 1;
+    first_row_ = first_row_is_header::value ? rows_start_ : header_start_;
+    header_buffer_ = buffer_;
+    truncated_ = 0;
+    newline_ = '\n';
+    crlf_ = false;
+    header_cells_.clear();
+    column_slots_.clear();
+#if __CSV2_HAS_MMAN_H__
+    header_mmap_.unmap();
+#endif
+    if (buffer_size_ == 0)
+      return;
+
+    detect_line_ending_();
+
+    // skip the leading lines, comments and (optionally) empty lines,
+    // the header is the next line
+    for (size_t line = 0; line < skip_rows::value && header_start_ < buffer_size_; ++line) {
+      const char *ptr = static_cast<const char *>(
+          memchr(&buffer_[header_start_], newline_, buffer_size_ - header_start_));
+      header_start_ = ptr ? (ptr - buffer_) + 1 : buffer_size_;
+    }
+    header_start_ = std::min(skip_lines_(buffer_, buffer_size_, newline_, header_start_),
+                             buffer_size_);
+
+    header_end_ = row_end_(buffer_, buffer_size_, newline_, header_start_);
+    if (header_end_ < buffer_size_)
+      rows_start_ = header_end_ + 1;
+    first_row_ = first_row_is_header::value ? rows_start_ : header_start_;
+    if (crlf_ && header_end_ > header_start_ && buffer_[header_end_ - 1] == '\r')
+      header_end_ -= 1;
+
+    Row header;
+    header.reader_ = this;
+    header.buffer_ = buffer_;
+    header.start_ = header_start_;
+    header.end_ = header_end_;
+    for (const auto cell : header)
+      header_cells_.push_back(cell);
+
+    size_t capacity = 4;
+    while (capacity < header_cells_.size() * 2)
+      capacity *= 2;
+    column_slots_.assign(capacity, 0);
+    for (size_t i = 0; i < header_cells_.size(); ++i) {
+      const auto span = unquoted_(header_cells_[i]);
+      size_t slot = hash_name_(buffer_ + span.first, span.second - span.first) & (capacity - 1);
+      while (column_slots_[slot] != 0)
+        slot = (slot + 1) & (capacity - 1);
+      column_slots_[slot] = i + 1;
+    }
+  }
+
+  // Can `c` be part of a blank line (other than its terminator)?
+  static bool blank_character_(char c, char newline) {
+    return c == ' ' || c == '\t' || (c == '\r' && newline != '\r');
+  }
+
+  // Does the line [first, last) start with the comment character?
+  static bool comment_line_(const char *first, const char *last) {
+    return comment_character::value != '\0' && first != last &&
+           *first == comment_character::value;
+  }
+
+  // Is the line [first, last), without its terminator, empty or whitespace?
+  bool blank_line_(const char *first, const char *last) const {
+    while (first != last && blank_character_(*first, newline_))
+      ++first;
+    return first == last;
+  }
+
+#if __CSV2_HAS_MMAN_H__
+  // Maps a growing prefix of the file, advised as sequential, until it holds
+  // the first limit_ rows, then truncates the buffer after them
+  template <typename StringType> bool mmap_head_(StringType &&filename) {
+    const size_t file_size = file_size_(filename);
+    if (file_size == 0)
+      return false;
+
+    for (size_t length = size_t(64) << 10;; length *= 2) {
+      length = std::min(length, file_size);
+      std::error_code error;
+      mmap_.map(filename, 0, length, error);
+      if (error)
+        return false;
+#if defined(POSIX_MADV_SEQUENTIAL)
+      posix_madvise(const_cast<char *>(mmap_.data()), mmap_.mapped_length(),
+                    POSIX_MADV_SEQUENTIAL);
+#endif
+      buffer_ = mmap_.data();
+      buffer_size_ = mmap_.mapped_length();
+      index_();
+      if (truncate_() || length == file_size)
+        return true;
+    }
+  }
+
+  // Size of the file at `path`, 0 if it cannot be opened
+  template <typename StringType> static size_t file_size_(StringType &&path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    const std::streamoff size = file ? static_cast<std::streamoff>(file.tellg()) : 0;
+    return size > 0 ? static_cast<size_t>(size) : 0;
+  }
+
+  // Offset after the last line terminator (outside quotes) in the buffer,
+  // i.e., where follow() picks up; the start of the rows if there is none.
+  // After limit(n), that is the terminator of the n-th row, cut by truncate_
+  size_t complete_end_() const {
+    if (truncated_)
+      return truncated_;
+    const size_t first = std::min(begin().start_, buffer_size_);
+    bool odd = false; // odd number of quote characters after `position`?
+    for (size_t position = buffer_size_;;) {
+      const char *found = detail::find_last(buffer_ + first, buffer_ + position, newline_);
+      if (not found)
+        return first;
+      const size_t next = found - buffer_ + 1;
+      if (quoted_newlines::value)
+        odd = odd != odd_quotes_(buffer_ + next, buffer_ + position);
+      if (not odd)
+        return next;
+      position = next - 1;
+    }
+  }
+#endif
+
+  // Truncates the buffer after the limit_-th row; false if the buffer ends
+  // before that row is complete
+  bool truncate_() {
+    if (limit_ == 0 || !buffer_)
+      return false;
+    size_t count{0};
+    for (auto it = begin(), last = end(); it != last; ++it) {
+      *it;
+      if (++count == limit_) {
+        if (it.end_ >= buffer_size_)
+          return false;
+        buffer_size_ = it.end_;
+        truncated_ = it.end_ + 1;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // The first row boundary at or after `offset` (0 < offset <= size), with
+  // rows that span lines; buffer_size_ + 1 if there is none
+  size_t resync_(size_t offset) const {
+    const size_t quotes =
+        detail::count(buffer_ + offset, buffer_size_ - offset, quote_character::value);
+    return resync_(offset, quotes % 2 != 0);
+  }
+
+  // Same, given whether `offset` lies inside a quoted section
+  size_t resync_(size_t offset, bool inside) const {
+    if (not inside and buffer_[offset - 1] == newline_)
+      return offset;
+    for (size_t i = offset; i < buffer_size_; ++i) {
+      if (buffer_[i] == quote_character::value)
+        inside = not inside;
+      else if (buffer_[i] == newline_ and not inside)
+        return i + 1;
+    }
+    return buffer_size_ + 1;
+  }
+
+  // See csv2::split_points
+  std::vector<size_t> split_points_(size_t count) const {
+    count = std::max<size_t>(count, 1);
+    const size_t first = std::min(first_row_, buffer_size_), length = buffer_size_ - first;
+    std::vector<size_t> targets(count + 1), result(count + 1, buffer_size_);
+    for (size_t i = 0; i < count; ++i)
+      targets[i] = first + length / count * i + std::min(i, length % count);
+    targets[count] = buffer_size_;
+    result[0] = first;
+
+    // with quoted newlines, whether each target lies inside quotes follows
+    // from the parity of the quotes after it: one count per chunk
+    std::vector<char> inside(count + 1, 0);
+    if (quoted_newlines::value) {
+      std::vector<size_t> quotes(count);
+      const size_t threads = length < (size_t(64) << 20) ? 1 : detail::thread_count(0);
+      detail::parallel_for(count, threads, [&](size_t i) {
+        quotes[i] = detail::count(buffer_ + targets[i], targets[i + 1] - targets[i],
+                                  quote_character::value);
+      });
+      for (size_t i = count; i-- > 0;)
+        inside[i] = inside[i + 1] != (quotes[i] % 2 != 0);
+    }
+
+    for (size_t i = 1; i < count; ++i) {
+      size_t offset = first;
+      if (targets[i] > first)
+        offset = quoted_newlines::value ? resync_(targets[i], inside[i] != 0)
+                                        : begin(targets[i]).start_;
+      result[i] = std::max(result[i - 1], std::min(offset, buffer_size_));
+    }
+    return result;
+  }
+
+  // See csv2::sample
+  std::vector<Row> sample_(size_t count, uint64_t seed) const {
+    std::vector<Row> result;
+    if (!buffer_ || count == 0 || first_row_ >= buffer_size_)
+      return result;
+    std::mt19937_64 random(seed);
+
+    // probing pays off if the sample is a small part of the rows
+    if (not quoted_newlines::value && count * 8 < estimate_rows(8).rows) {
+      std::uniform_int_distribution<size_t> offsets(first_row_, buffer_size_ - 1);
+      std::uniform_real_distribution<double> uniform(0.0, 1.0);
+      std::unordered_set<size_t> starts;
+      size_t shortest = buffer_size_ + 1; // shortest row probed so far
+      for (size_t probe = 0; probe < 256 * count + 1024 && result.size() < count; ++probe) {
+        // the row holding a random byte, picked with a probability
+        // proportional to its length
+        const size_t offset = offsets(random);
+        const char *found = detail::find_last(buffer_ + first_row_, buffer_ + offset, newline_);
+        const size_t start = found ? found - buffer_ + 1 : first_row_;
+        const size_t end = row_end_(buffer_, buffer_size_, newline_, start);
+        if (comment_line_(buffer_ + start, buffer_ + end) or
+            (ignore_empty_lines::value and blank_line_(buffer_ + start, buffer_ + end)))
+          continue;
+
+        // rows are accepted with probability shortest / length, which undoes
+        // the length bias; when a shorter row turns up, the rows accepted so
+        // far are thinned out to match the new ratio
+        const size_t length = std::min(end + 1, buffer_size_) - start;
+        if (length < shortest) {
+          size_t kept{0};
+          for (size_t i = 0; i < result.size(); ++i) {
+            if (uniform(random) * shortest < length)
+              result[kept++] = result[i];
+            else
+              starts.erase(result[i].start_);
+          }
+          result.resize(kept);
+          shortest = length;
+        }
+        if (uniform(random) * length < shortest && starts.insert(start).second)
+          result.push_back(row_(start, end));
+      }
+      if (result.size() == count) {
+        std::sort(result.begin(), result.end(),
+                  [](const Row &a, const Row &b) { return a.start_ < b.start_; });
+        return result;
+      }
+      result.clear();
+    }
+
+    // exact reservoir sampling over all rows
+    size_t seen{0};
+    for (auto it = begin(), last = end(); it != last; ++it) {
+      const Row row = *it;
+      if (row.start_ >= buffer_size_)
+        break; // the empty row after a trailing line terminator
+      if (seen < count) {
+        result.push_back(row);
+      } else {
+        const size_t slot = std::uniform_int_distribution<size_t>(0, seen)(random);
+        if (slot < count)
+          result[slot] = row;
+      }
+      ++seen;
+    }
+    std::sort(result.begin(), result.end(),
+              [](const Row &a, const Row &b) { return a.start_ < b.start_; });
+    return result;
+  }
+
+  // Is the number of quote characters in [first, last) odd?
+  static bool odd_quotes_(const char *first, const char *last) {
+    const char quote = quote_character::value;
+    return std::count(first, last, quote) % 2 != 0;
+  }
+
+  // The row [start, end), without a trailing '\r' of a "\r\n" ending
+  Row row_(size_t start, size_t end) const { return row_(buffer_, start, end); }
+  Row row_(const char *buffer, size_t start, size_t end) const {
     Row result;
-    result.buffer_ = buffer_;
+    result.reader_ = this;
+    result.buffer_ = buffer;
     result.start_ = start;
     result.end_ = end;
+    if (crlf_ && end > start && buffer[end - 1] == '\r')
+      result.end_ = end - 1;
+    return result;
+  }
 
-    if (const char *ptr =
-            static_cast<const char *>(memchr(&buffer_[start], '\n', (buffer_size_ - start)))) {
-      end = start + (ptr - &buffer_[start]);
-      result.end_ = end;
+  // Number of rows ended by a line terminator in [first, last), where
+  // `first` is the start of a line
+  size_t window_rows_(const char *first, const char *last) const {
+    if (comment_character::value == '\0' && not ignore_empty_lines::value)
+      return detail::count_lines(first, last - first, newline_, quote_character::value,
+                                 quoted_newlines::value)
+          .outside;
+    size_t result{0};
+    for (const char *p = first; (p = static_cast<const char *>(memchr(p, newline_, last - p)));
+         first = ++p) {
+      if (not comment_line_(first, p) and
+          (not ignore_empty_lines::value or not blank_line_(first, p)))
+        ++result;
+    }
+    return result;
+  }
+
+  // Returns the index of the line terminator that ends the row starting at
+  // `start`, or buffer_size for the last row; with quoted_newlines, line
+  // terminators inside quoted sections do not end the row
+  static size_t row_end_(const char *buffer, size_t buffer_size, char newline, size_t start) {
+    bool inside = false;
+    for (size_t search = start; search < buffer_size;) {
+      const char *ptr =
+          static_cast<const char *>(memchr(&buffer[search], newline, buffer_size - search));
+      if (not ptr)
+        break;
+      const size_t end = ptr - buffer;
+      if (!quoted_newlines::value)
+        return end;
+      for (size_t i = search; i < end; ++i)
+        inside = inside != (buffer[i] == quote_character::value);
+      if (!inside)
+        return end;
+      search = end + 1;
+    }
+    return buffer_size;
+  }
+
+  // Returns the start of the first line at or after the line starting at
+  // `start` that is neither a comment nor, if ignore_empty_lines, blank;
+  // buffer_size + 1 if there is none
+  static size_t skip_lines_(const char *buffer, size_t buffer_size, char newline, size_t start) {
+    if (comment_character::value == '\0' && !ignore_empty_lines::value)
+      return start;
+    while (start <= buffer_size) {
+      size_t i = start;
+      if (ignore_empty_lines::value) {
+        while (i < buffer_size && blank_character_(buffer[i], newline))
+          ++i;
+        if (i == buffer_size) {
+          start = buffer_size + 1;
+          break;
+        }
+        if (buffer[i] == newline) {
+          start = i + 1;
+          continue;
+        }
+      }
+      if (comment_character::value == '\0' || start == buffer_size ||
+          buffer[start] != comment_character::value)
+        break;
+      const char *ptr = static_cast<const char *>(memchr(&buffer[i], newline, buffer_size - i));
+      start = ptr ? (ptr - buffer) + 1 : buffer_size + 1;
     }
+    return start;
+  }
+
+public:
+
+  Row header() const {
+    Row result;
+    result.reader_ = this;
+    result.buffer_ = header_buffer_;
+    result.start_ = header_start_;
+    result.end_ = header_end_;
     return result;
   }
 
   /**
-   * @returns The number of rows (excluding the header)
+   * @returns The index of the header column called `name` (trimmed,
+   * with enclosing quotes removed), or std::string::npos if there is none.
+   * Duplicate names resolve to the leftmost column.
   */
-  size_t rows(bool ignore_empty_lines = false) const {
+  size_t column_index(const char *name, size_t length) const {
+    if (column_slots_.empty())
+      return std::string::npos;
+    const size_t mask = column_slots_.size() - 1;
+    size_t result = std::string::npos;
+    for (size_t slot = hash_name_(name, length) & mask; column_slots_[slot] != 0;
+         slot = (slot + 1) & mask) {
+      const size_t index = column_slots_[slot] - 1;
+      const auto span = unquoted_(header_cells_[index]);
+      if (span.second - span.first == length &&
+          memcmp(header_buffer_ + span.first, name, length) == 0 && index < result)
+        result = index;
+    }
+    return result;
+  }
+
+  // Name of header column `index` as used by column_index, or "" if out of range
+  std::string column_name(size_t index) const {
+    if (index >= header_cells_.size())
+      return std::string();
+    const auto span = unquoted_(header_cells_[index]);
+    return std::string(header_buffer_ + span.first, header_buffer_ + span.second);
+  }
+
+  size_t column_index(const char *name) const { return column_index(name, strlen(name)); }
+  size_t column_index(const std::string &name) const {
+    return column_index(name.data(), name.size());
+  }
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+  size_t column_index(std::string_view name) const {
+    return column_index(name.data(), name.size());
+  }
+#endif
+
+  /**
+   * @returns The number of rows (excluding the header), i.e., the number of
+   * rows visited by begin()..end(). Empty and whitespace-only lines are not
+   * counted if skip_empty_lines or the ignore_empty_lines policy is set.
+   * Without comments or empty-line skipping, line terminators are counted
+   * 64 bytes at a time (vector compare + popcount), on all hardware threads
+   * for buffers of 64 MB and more
+  */
+  size_t rows(bool skip_empty_lines = false) const {
     size_t result{0};
     if (!buffer_ || buffer_size_ == 0)
       return result;
-    
-    // Count the first row if not header
-    if (not first_row_is_header::value
-        and (not ignore_empty_lines
-        or *(static_cast<const char*>(buffer_)) != '\r'))
-      ++result;
 
-    for (const char *p = buffer_
-        ; (p = static_cast<const char *>(memchr(p, '\n', (buffer_ + buffer_size_) - p)))
-        ; ++p) {
-      if (ignore_empty_lines
-          and (p >= buffer_ + buffer_size_ - 1
-          or *(p + 1) == '\r'))
-        continue;
-      ++result;
+    const bool skip_empty = skip_empty_lines || ignore_empty_lines::value;
+    const char *last = buffer_ + buffer_size_;
+    const char *row = buffer_ + first_row_;
+    if (row > last)
+      return result;
+
+    // every line terminator (outside quotes) ends a row, plus the last row
+    if (comment_character::value == '\0' && not skip_empty)
+      return detail::count_lines_parallel(row, last - row, newline_, quote_character::value,
+                                          quoted_newlines::value) +
+             1;
+
+    if (quoted_newlines::value) {
+      for (auto it = begin(), end_it = end(); it != end_it; ++it) {
+        const Row current = *it;
+        if (not skip_empty or not blank_line_(buffer_ + current.start_, buffer_ + current.end_))
+          ++result;
+      }
+      return result;
+    }
+    for (const char *p = row; (p = static_cast<const char *>(memchr(p, newline_, last - p)));
+         row = ++p) {
+      if (not comment_line_(row, p) and (not skip_empty or not blank_line_(row, p)))
+        ++result;
     }
+    // the last row (after the last line terminator)
+    if (not comment_line_(row, last) and (not skip_empty or not blank_line_(row, last)))
+      ++result;
     return result;
   }
 
-  size_t cols() const {
-    size_t result{0};
-    for (const auto cell : header())
-      result += 1;
-    return result;
+  /**
+   * Estimates rows() from `samples` evenly spaced 64 KB windows of the buffer,
+   * extrapolating the rows per byte seen in the windows (ratio estimator) to
+   * the whole buffer. Only the windows are read; buffers too small to sample
+   * are counted exactly
+  */
+  RowEstimate estimate_rows(size_t samples = 32) const {
+    const size_t window = size_t(64) << 10;
+    samples = std::max<size_t>(samples, 2);
+    const size_t first = first_row_;
+    if (!buffer_ || first > buffer_size_ || buffer_size_ - first <= 2 * samples * window) {
+      const size_t count = rows();
+      return RowEstimate{count, count, count, true};
+    }
+
+    const char *last = buffer_ + buffer_size_;
+    const size_t length = buffer_size_ - first;
+    std::vector<double> counts(samples), sizes(samples);
+    double total_count = 0, total_size = 0;
+    for (size_t i = 0; i < samples; ++i) {
+      // each window starts at the beginning of a line
+      const char *start = buffer_ + first + i * ((length - window) / (samples - 1));
+      if (i > 0) {
+        const char *ptr = static_cast<const char *>(memchr(start - 1, newline_, last - start + 1));
+        start = ptr ? ptr + 1 : last;
+      }
+      const size_t size = std::min<size_t>(window, last - start);
+      counts[i] = static_cast<double>(window_rows_(start, start + size));
+      sizes[i] = static_cast<double>(size);
+      total_count += counts[i];
+      total_size += sizes[i];
+    }
+    if (total_size == 0) {
+      const size_t count = rows();
+      return RowEstimate{count, count, count, true};
+    }
+
+    const double ratio = total_count / total_size, mean_size = total_size / samples;
+    double variance = 0;
+    for (size_t i = 0; i < samples; ++i)
+      variance += (counts[i] - ratio * sizes[i]) * (counts[i] - ratio * sizes[i]);
+    variance /= samples * (samples - 1) * mean_size * mean_size;
+
+    // +1 for the last row, which has no line terminator
+    const double estimate = ratio * length + 1, margin = 1.96 * std::sqrt(variance) * length;
+    const double lower = std::max(1.0, estimate - margin),
+                 upper = std::min(static_cast<double>(length + 1), estimate + margin);
+    return RowEstimate{static_cast<size_t>(estimate + 0.5), static_cast<size_t>(lower),
+                       static_cast<size_t>(std::ceil(upper)), false};
   }
+
+  size_t cols() const { return header_cells_.size(); }
 };
+
+// Splits the rows of `reader` into `count` chunks of roughly equal size at
+// row boundaries, e.g., for separate worker processes that each map their
+// chunk with Reader::mmap(path, offset, length). Returns count + 1 offsets;
+// chunk i holds the rows starting in [offsets[i], offsets[i + 1]). Rows that
+// span lines (quoted_newlines) are never split
+template <class Reader> std::vector<size_t> split_points(const Reader &reader, size_t count) {
+  return reader.split_points_(count);
+}
+
+namespace detail {
+
+// Iterator at an offset from split_points. Offsets inside the buffer are
+// row starts; reader.size() is clamped "no more rows", which begin(offset)
+// maps to end(), or to the empty row after a trailing line terminator
+template <class Reader>
+typename Reader::RowIterator split_iterator(const Reader &reader, size_t offset) {
+  typedef typename Reader::RowIterator RowIterator;
+  return offset < reader.size() ? RowIterator(reader.data(), reader.size(), offset, &reader)
+                                : reader.begin(offset);
+}
+
+// The rows of chunk `i` of split_points `offsets`, as [first, second); the
+// last chunk runs up to reader.end() like iteration
+template <class Reader>
+std::pair<typename Reader::RowIterator, typename Reader::RowIterator>
+chunk_bounds(const Reader &reader, const std::vector<size_t> &offsets, size_t i) {
+  return std::make_pair(i == 0 ? reader.begin() : split_iterator(reader, offsets[i]),
+                        i + 2 == offsets.size() ? reader.end()
+                                                : split_iterator(reader, offsets[i + 1]));
+}
+
+} // namespace detail
+
+// Picks `count` rows of `reader` (all rows if there are fewer) at random,
+// returned in buffer order. For samples that are a small part of a large
+// buffer, random byte offsets are probed: the row holding the byte is
+// accepted with a probability inversely proportional to its length, which
+// undoes the bias towards long rows, so only O(count) pages are touched.
+// Otherwise, and with quoted_newlines, all rows are reservoir-sampled
+template <class Reader>
+std::vector<typename Reader::Row> sample(const Reader &reader, size_t count, uint64_t seed) {
+  return reader.sample_(count, seed);
+}
+
 } // namespace csv2
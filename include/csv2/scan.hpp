@@ -0,0 +1,242 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <csv2/parallel.hpp>
+#include <vector>
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) ||                              \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define __CSV2_HAS_SSE2__ 1
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace csv2 {
+
+namespace detail {
+
+inline size_t popcount(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<size_t>(__builtin_popcountll(x));
+#elif defined(_MSC_VER) && defined(_M_X64)
+  return static_cast<size_t>(__popcnt64(x));
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return static_cast<size_t>((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+inline size_t trailing_zeros(uint32_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<size_t>(__builtin_ctz(x));
+#elif defined(_MSC_VER)
+  unsigned long result;
+  _BitScanForward(&result, x);
+  return static_cast<size_t>(result);
+#else
+  size_t result = 0;
+  for (; (x & 1) == 0; x >>= 1)
+    ++result;
+  return result;
+#endif
+}
+
+inline size_t leading_zeros(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<size_t>(__builtin_clzll(x));
+#elif defined(_MSC_VER) && defined(_M_X64)
+  unsigned long result;
+  _BitScanReverse64(&result, x);
+  return static_cast<size_t>(63 - result);
+#else
+  size_t result = 0;
+  for (; (x & (uint64_t(1) << 63)) == 0; x <<= 1)
+    ++result;
+  return result;
+#endif
+}
+
+// Bit i is set if first[i] == c, for the 64 bytes at `first`
+inline uint64_t match_mask(const char *first, char c) {
+#if defined(__AVX2__)
+  const __m256i needle = _mm256_set1_epi8(c);
+  const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+  const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first + 32));
+  return uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, needle)))) |
+         (uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, needle)))) << 32);
+#elif __CSV2_HAS_SSE2__
+  const __m128i needle = _mm_set1_epi8(c);
+  uint64_t result = 0;
+  for (int i = 0; i < 4; ++i) {
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first + 16 * i));
+    result |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)))) << (16 * i);
+  }
+  return result;
+#else
+  uint64_t result = 0;
+  for (int i = 0; i < 64; ++i)
+    result |= uint64_t(first[i] == c) << i;
+  return result;
+#endif
+}
+
+// Bit i is set if an odd number of bits in [0, i] are set, i.e., with
+// a quote mask as input, the bits inside (and opening) quoted sections
+inline uint64_t prefix_xor(uint64_t x) {
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+}
+
+// Returns the last occurrence of `c` in [first, last), or nullptr; uses
+// memrchr where available, else compares 64 bytes at a time from the end
+inline const char *find_last(const char *first, const char *last, char c) {
+#if defined(__GLIBC__) && defined(_GNU_SOURCE)
+  return static_cast<const char *>(memrchr(first, c, last - first));
+#else
+  while (last - first >= 64) {
+    last -= 64;
+    if (const uint64_t mask = match_mask(last, c))
+      return last + 63 - leading_zeros(mask);
+  }
+  while (last != first) {
+    if (*--last == c)
+      return last;
+  }
+  return nullptr;
+#endif
+}
+
+// Returns the first occurrence of [needle, needle + length) in [first, last),
+// or nullptr. Candidates are found by comparing the first and the last byte
+// of the needle at 32 (AVX2) or 16 (SSE2) positions at a time, and confirmed
+// with memcmp
+inline const char *find(const char *first, const char *last, const char *needle, size_t length) {
+  if (length == 0)
+    return first;
+  if (static_cast<size_t>(last - first) < length)
+    return nullptr;
+  if (length == 1)
+    return static_cast<const char *>(memchr(first, *needle, last - first));
+
+  const char *end = last - length + 1; // candidates start in [first, end)
+#if defined(__AVX2__)
+  const __m256i head = _mm256_set1_epi8(needle[0]), tail = _mm256_set1_epi8(needle[length - 1]);
+  for (; end - first >= 32; first += 32) {
+    const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+    const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first + length - 1));
+    uint32_t mask = uint32_t(
+        _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, head), _mm256_cmpeq_epi8(b, tail))));
+    for (; mask != 0; mask &= mask - 1) {
+      const char *candidate = first + trailing_zeros(mask);
+      if (memcmp(candidate + 1, needle + 1, length - 2) == 0)
+        return candidate;
+    }
+  }
+#elif __CSV2_HAS_SSE2__
+  const __m128i head = _mm_set1_epi8(needle[0]), tail = _mm_set1_epi8(needle[length - 1]);
+  for (; end - first >= 16; first += 16) {
+    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first + length - 1));
+    uint32_t mask =
+        uint32_t(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, head), _mm_cmpeq_epi8(b, tail))));
+    for (; mask != 0; mask &= mask - 1) {
+      const char *candidate = first + trailing_zeros(mask);
+      if (memcmp(candidate + 1, needle + 1, length - 2) == 0)
+        return candidate;
+    }
+  }
+#endif
+  for (; first < end; ++first) {
+    if (*first == needle[0] && first[length - 1] == needle[length - 1] &&
+        memcmp(first + 1, needle + 1, length - 2) == 0)
+      return first;
+  }
+  return nullptr;
+}
+
+// Number of occurrences of `c` in [first, first + length), 64 bytes at a time
+inline size_t count(const char *first, size_t length, char c) {
+  size_t result = 0, i = 0;
+  for (; length - i >= 64; i += 64)
+    result += popcount(match_mask(first + i, c));
+  for (; i < length; ++i)
+    result += first[i] == c;
+  return result;
+}
+
+struct line_count {
+  size_t outside; // line terminators outside quotes, if the range starts outside
+  size_t total;   // all line terminators
+  bool odd;       // odd number of quote characters?
+};
+
+// Counts the line terminators in [first, first + length), 64 bytes at a
+// time with a vector compare and popcount. If `quoted`, terminators inside
+// quoted sections are told apart through the prefix-XOR of the quote mask
+inline line_count count_lines(const char *first, size_t length, char newline, char quote,
+                              bool quoted) {
+  line_count result{0, 0, false};
+  uint64_t inside = 0; // all ones while in a quoted section
+  char tail[64], padding = '\0';
+  while (padding == newline || padding == quote)
+    ++padding;
+  for (size_t i = 0; i < length; i += 64) {
+    const char *block = first + i;
+    if (length - i < 64) {
+      memset(tail, padding, sizeof(tail));
+      memcpy(tail, block, length - i);
+      block = tail;
+    }
+    const uint64_t lines = match_mask(block, newline);
+    result.total += popcount(lines);
+    if (quoted) {
+      const uint64_t quotes = prefix_xor(match_mask(block, quote)) ^ inside;
+      result.outside += popcount(lines & ~quotes);
+      inside = uint64_t(0) - (quotes >> 63);
+    }
+  }
+  result.outside = quoted ? result.outside : result.total;
+  result.odd = inside != 0;
+  return result;
+}
+
+// Same as count_lines, but splits buffers of `threshold` bytes or more
+// over `threads` threads (0 = one per hardware thread); returns the number
+// of terminators outside quotes
+inline size_t count_lines_parallel(const char *first, size_t length, char newline, char quote,
+                                   bool quoted, size_t threshold = size_t(64) << 20,
+                                   size_t threads = 0) {
+  threads = length < threshold ? 1 : thread_count(threads);
+  if (threads == 1 || length == 0)
+    return count_lines(first, length, newline, quote, quoted).outside;
+
+  // chunks start on 64-byte boundaries and together cover all of the buffer
+  const size_t chunks = threads * 4, chunk_size = ((length + chunks - 1) / chunks + 63) / 64 * 64;
+  std::vector<line_count> counts(chunks);
+  parallel_for(chunks, threads, [&](size_t chunk) {
+    const size_t begin = std::min(length, chunk * chunk_size);
+    const size_t end = std::min(length, begin + chunk_size);
+    counts[chunk] = count_lines(first + begin, end - begin, newline, quote, quoted);
+  });
+
+  // a chunk that starts inside quotes sees the complement of its quote mask
+  size_t result = 0;
+  bool inside = false;
+  for (const auto &count : counts) {
+    result += inside ? count.total - count.outside : count.outside;
+    inside = inside != count.odd;
+  }
+  return result;
+}
+
+} // namespace detail
+
+} // namespace csv2
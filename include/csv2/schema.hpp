@@ -0,0 +1,182 @@
+#pragma once
+#include <csv2/parallel.hpp>
+#include <csv2/reader.hpp>
+#include <string>
+#include <vector>
+
+namespace csv2 {
+
+enum class data_type { boolean, integer, floating, date, timestamp, string };
+
+struct Column {
+  std::string name;
+  data_type type;
+  bool nullable;
+};
+
+struct Schema {
+  std::vector<Column> columns;
+  size_t sampled_rows;
+};
+
+struct SchemaOptions {
+  size_t rows = 4096;  // number of rows to sample in total
+  size_t windows = 64; // evenly spaced windows the rows are taken from
+  size_t threads = 0;  // 0 = one per hardware thread
+  NullValues nulls;    // tokens that mark a missing value
+};
+
+namespace detail {
+
+// Set of data_types a cell (or a column) is compatible with
+struct type_set {
+  unsigned mask;
+
+  static constexpr unsigned bit(data_type type) { return 1u << static_cast<unsigned>(type); }
+  static constexpr unsigned all() { return (bit(data_type::string) << 1) - 1; }
+
+  // Most specific type in the set; string is always a member
+  data_type narrowest() const {
+    for (unsigned type = 0; type < static_cast<unsigned>(data_type::string); ++type)
+      if (mask & (1u << type))
+        return static_cast<data_type>(type);
+    return data_type::string;
+  }
+};
+
+enum char_class : unsigned char {
+  char_digit = 1,
+  char_sign = 2,   // + -
+  char_number = 4, // . e E
+  char_date = 8,   // : T Z and space
+  char_other = 16
+};
+
+// Classes of all 256 byte values, so that a cell can be classified with
+// one table lookup and OR per character before any parser runs
+inline const unsigned char *char_classes() {
+  static const struct table {
+    unsigned char classes[256];
+    table() {
+      for (unsigned c = 0; c < 256; ++c)
+        classes[c] = char_other;
+      for (unsigned c = '0'; c <= '9'; ++c)
+        classes[c] = char_digit;
+      classes[unsigned('+')] = classes[unsigned('-')] = char_sign;
+      classes[unsigned('.')] = classes[unsigned('e')] = classes[unsigned('E')] = char_number;
+      classes[unsigned(':')] = classes[unsigned('T')] = classes[unsigned('Z')] = char_date;
+      classes[unsigned(' ')] = char_date;
+    }
+  } instance;
+  return instance.classes;
+}
+
+} // namespace detail
+
+// Classifies a (non-null) cell into the set of types it is compatible with
+template <> struct convert<detail::type_set> {
+  static bool parse(const char *first, const char *last, detail::type_set &result) {
+    typedef detail::type_set types;
+    const size_t length = last - first;
+    result.mask = types::bit(data_type::string);
+    if (length == 0)
+      return true;
+
+    const unsigned char *classes = detail::char_classes();
+    unsigned seen = 0;
+    for (const char *c = first; c != last; ++c)
+      seen |= classes[static_cast<unsigned char>(*c)];
+
+    bool flag;
+    if (seen & detail::char_other) {
+      if (convert<bool>::parse(first, last, flag) && length > 1)
+        result.mask |= types::bit(data_type::boolean);
+      return true;
+    }
+
+    int64_t integer;
+    double floating;
+    timestamp time;
+    if (!(seen & (detail::char_number | detail::char_date)) &&
+        convert<int64_t>::parse(first, last, integer))
+      result.mask |= types::bit(data_type::integer) | types::bit(data_type::floating);
+    else if (!(seen & detail::char_date) && convert<double>::parse(first, last, floating))
+      result.mask |= types::bit(data_type::floating);
+    else if (convert<timestamp>::parse(first, last, time))
+      result.mask |= types::bit(data_type::timestamp) |
+                     (length == 10 ? types::bit(data_type::date) : 0u);
+    return true;
+  }
+};
+
+// Infers the type and nullability of every header column from rows sampled
+// at evenly spaced offsets across the buffer. The windows are classified in
+// parallel and their results merged; a column is nullable if a sampled cell
+// is missing or one of options.nulls, and a column without any non-null
+// sample is a string
+template <class Reader> Schema infer_schema(const Reader &reader, const SchemaOptions &options) {
+  struct state {
+    std::vector<unsigned> types; // compatible types per column
+    std::vector<bool> nullable;
+    std::vector<bool> seen;
+    size_t rows = 0;
+  };
+
+  const size_t cols = reader.cols();
+  const size_t windows = options.windows == 0 ? 1 : options.windows;
+  const size_t quota = (options.rows + windows - 1) / windows;
+  const auto offsets = split_points(reader, windows);
+
+  std::vector<state> states(windows);
+  detail::parallel_for(windows, options.threads, [&](size_t window) {
+    state &result = states[window];
+    result.types.assign(cols, detail::type_set::all());
+    result.nullable.assign(cols, false);
+    result.seen.assign(cols, false);
+    for (auto it = detail::chunk_bounds(reader, offsets, window);
+         result.rows < quota && it.first != it.second; ++it.first) {
+      const auto row = *it.first;
+      if (row.length() == 0)
+        continue;
+      size_t col = 0;
+      for (auto cell = row.begin(), cells_end = row.end(); col < cols && cell != cells_end;
+           ++cell, ++col) {
+        const auto value = *cell;
+        detail::type_set types;
+        if (value.is_null(options.nulls)) {
+          result.nullable[col] = true;
+        } else {
+          value.get(types);
+          result.types[col] &= types.mask;
+          result.seen[col] = true;
+        }
+      }
+      for (; col < cols; ++col)
+        result.nullable[col] = true;
+      result.rows += 1;
+    }
+  });
+
+  Schema result;
+  result.sampled_rows = 0;
+  for (size_t col = 0; col < cols; ++col) {
+    detail::type_set types{detail::type_set::all()};
+    bool nullable = false, seen = false;
+    for (const auto &window : states) {
+      types.mask &= window.types[col];
+      nullable = nullable || window.nullable[col];
+      seen = seen || window.seen[col];
+    }
+    result.columns.push_back(
+        Column{reader.column_name(col), seen ? types.narrowest() : data_type::string, nullable});
+  }
+  for (const auto &window : states)
+    result.sampled_rows += window.rows;
+  return result;
+}
+
+template <class Reader> Schema infer_schema(const Reader &reader) {
+  return infer_schema(reader, SchemaOptions());
+}
+
+} // namespace csv2
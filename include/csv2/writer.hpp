@@ -1,12 +1,22 @@
 
 #pragma once
+#include <algorithm>
 #include <cstring>
 #include <csv2/parameters.hpp>
 #include <fstream>
 #include <iostream>
 #include <iterator>
+#include <stdexcept>
 #include <string>
 #include <utility>
+#include <vector>
+#if __has_include(<sys/uio.h>)
+#define __CSV2_HAS_UIO_H__ 1
+#include <cerrno>
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
 
 namespace csv2 {
 
@@ -35,4 +45,111 @@ public:
   }
 };
 
+// Writes rows as their raw bytes in the source buffer (Row::address(),
+// Row::length()), each followed by `terminator`. Rows that are adjacent in
+// the source buffer are merged into a single range, and pending ranges are
+// written in batches: with writev(2) for file descriptors, or with one
+// write() call per range for streams
+class PassthroughWriter {
+  std::ostream *stream_{nullptr}; // output stream, or
+  int fd_{-1};                    // output file descriptor
+  std::string terminator_;        // written after each row
+  std::vector<std::pair<const char *, size_t>> ranges_; // pending writes
+
+public:
+  PassthroughWriter(std::ostream &stream, std::string terminator = "\n")
+      : stream_(&stream), terminator_(std::move(terminator)) {}
+#if __CSV2_HAS_UIO_H__
+  PassthroughWriter(int fd, std::string terminator = "\n")
+      : fd_(fd), terminator_(std::move(terminator)) {}
+#endif
+
+  ~PassthroughWriter() {
+    try {
+      flush();
+    } catch (...) {
+    }
+  }
+
+  template <typename Row> void write_row(const Row &row) { write_raw(row.address(), row.length()); }
+
+  template <typename Container> void write_rows(Container &&rows) {
+    for (const auto &row : rows)
+      write_row(row);
+  }
+
+  // Writes [data, data + length) followed by the terminator
+  void write_raw(const char *data, size_t length) {
+    if (!ranges_.empty()) {
+      auto &last = ranges_.back();
+      const char *end = last.first + last.second;
+      if (end + terminator_.size() == data &&
+          memcmp(end, terminator_.data(), terminator_.size()) == 0) {
+        last.second += terminator_.size() + length;
+        return;
+      }
+    }
+    if (ranges_.size() == batch_size_)
+      flush();
+    ranges_.emplace_back(data, length);
+  }
+
+  // Writes all pending ranges; throws std::runtime_error if the output fails
+  void flush() {
+    if (ranges_.empty())
+      return;
+#if __CSV2_HAS_UIO_H__
+    if (!stream_) {
+      std::vector<iovec> vectors;
+      vectors.reserve(2 * ranges_.size());
+      for (const auto &range : ranges_) {
+        vectors.push_back(iovec{const_cast<char *>(range.first), range.second});
+        vectors.push_back(iovec{const_cast<char *>(terminator_.data()), terminator_.size()});
+      }
+      ranges_.clear();
+      write_vectors_(vectors.data(), vectors.size());
+      return;
+    }
+#endif
+    for (const auto &range : ranges_) {
+      stream_->write(range.first, static_cast<std::streamsize>(range.second));
+      stream_->write(terminator_.data(), static_cast<std::streamsize>(terminator_.size()));
+    }
+    ranges_.clear();
+    if (!*stream_)
+      throw std::runtime_error("csv2: failed to write rows");
+  }
+
+private:
+  constexpr static size_t batch_size_ = 512; // ranges per flush
+
+#if __CSV2_HAS_UIO_H__
+  // writev, resuming after partial writes
+  void write_vectors_(iovec *vectors, size_t count) {
+#ifdef IOV_MAX
+    const size_t limit = IOV_MAX;
+#else
+    const size_t limit = 1024;
+#endif
+    while (count > 0) {
+      const ssize_t written = ::writev(fd_, vectors, static_cast<int>(std::min(count, limit)));
+      if (written < 0 && errno == EINTR)
+        continue;
+      if (written < 0)
+        throw std::runtime_error("csv2: failed to write rows");
+      for (size_t remaining = static_cast<size_t>(written); count > 0;) {
+        if (remaining < vectors->iov_len) {
+          vectors->iov_base = static_cast<char *>(vectors->iov_base) + remaining;
+          vectors->iov_len -= remaining;
+          break;
+        }
+        remaining -= vectors->iov_len;
+        ++vectors;
+        --count;
+      }
+    }
+  }
+#endif
+};
+
 } // namespace csv2
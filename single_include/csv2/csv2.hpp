@@ -105,7 +105,7 @@ inline size_t make_offset_page_aligned(size_t offset) noexcept {
 #define WIN32_LEAN_AND_MEAN
 #endif // WIN32_LEAN_AND_MEAN
 #include <windows.h>
-#else  // ifdef _WIN32
+#else // ifdef _WIN32
 #define INVALID_HANDLE_VALUE -1
 #endif // ifdef _WIN32
 
@@ -603,43 +603,25 @@ struct char_type_helper {
   using type = typename C::value_type;
 };
 
-template <class T> struct char_type {
-  using type = typename char_type_helper<T>::type;
-};
+template <class T> struct char_type { using type = typename char_type_helper<T>::type; };
 
 // TODO: can we avoid this brute force approach?
-template <> struct char_type<char *> {
-  using type = char;
-};
+template <> struct char_type<char *> { using type = char; };
 
-template <> struct char_type<const char *> {
-  using type = char;
-};
+template <> struct char_type<const char *> { using type = char; };
 
-template <size_t N> struct char_type<char[N]> {
-  using type = char;
-};
+template <size_t N> struct char_type<char[N]> { using type = char; };
 
-template <size_t N> struct char_type<const char[N]> {
-  using type = char;
-};
+template <size_t N> struct char_type<const char[N]> { using type = char; };
 
 #ifdef _WIN32
-template <> struct char_type<wchar_t *> {
-  using type = wchar_t;
-};
+template <> struct char_type<wchar_t *> { using type = wchar_t; };
 
-template <> struct char_type<const wchar_t *> {
-  using type = wchar_t;
-};
+template <> struct char_type<const wchar_t *> { using type = wchar_t; };
 
-template <size_t N> struct char_type<wchar_t[N]> {
-  using type = wchar_t;
-};
+template <size_t N> struct char_type<wchar_t[N]> { using type = wchar_t; };
 
-template <size_t N> struct char_type<const wchar_t[N]> {
-  using type = wchar_t;
-};
+template <size_t N> struct char_type<const wchar_t[N]> { using type = wchar_t; };
 #endif // _WIN32
 
 template <typename CharT, typename S> struct is_c_str_helper {
@@ -1578,8 +1560,434 @@ using shared_ummap_sink = basic_shared_mmap_sink<unsigned char>;
 } // namespace mio
 
 #endif // MIO_SHARED_MMAP_HEADER
+#pragma once
+#include <cfloat>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+	#include <string_view>
+#endif
+
+namespace csv2 {
+
+namespace detail {
+
+#if defined(_MSC_VER) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define __CSV2_SWAR_DIGITS__ 1
+#endif
+
+inline bool is_digit(char c) { return static_cast<unsigned char>(c) - unsigned('0') <= 9; }
+
+#if __CSV2_SWAR_DIGITS__
+// True if all eight bytes of `chunk` are ASCII digits
+inline bool is_eight_digits(uint64_t chunk) {
+  return ((chunk & 0xF0F0F0F0F0F0F0F0ULL) |
+          (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ==
+         0x3333333333333333ULL;
+}
+
+// Converts eight ASCII digits (little-endian load) to their value
+// with three multiplications instead of eight
+inline uint32_t parse_eight_digits(uint64_t chunk) {
+  const uint64_t mask = 0x000000FF000000FFULL;
+  const uint64_t mul1 = 0x000F424000000064ULL; // 100 + (1000000 << 32)
+  const uint64_t mul2 = 0x0000271000000001ULL; // 1 + (10000 << 32)
+  chunk -= 0x3030303030303030ULL;
+  chunk = (chunk * 10) + (chunk >> 8);
+  chunk = (((chunk & mask) * mul1) + (((chunk >> 16) & mask) * mul2)) >> 32;
+  return static_cast<uint32_t>(chunk);
+}
+#endif
+
+// Accumulates the digits at `first` into `mantissa`; returns false if
+// more than 19 significant digits are seen
+inline bool parse_digits(const char *&first, const char *last, uint64_t &mantissa,
+                         size_t &digits) {
+#if __CSV2_SWAR_DIGITS__
+  uint64_t chunk;
+  while (last - first >= 8 && (memcpy(&chunk, first, 8), is_eight_digits(chunk))) {
+    if (digits + 8 > 19)
+      return false;
+    mantissa = mantissa * 100000000ULL + parse_eight_digits(chunk);
+    digits += 8;
+    first += 8;
+  }
+#endif
+  for (; first != last && is_digit(*first); ++first) {
+    if (++digits > 19)
+      return false;
+    mantissa = mantissa * 10 + static_cast<unsigned>(*first - '0');
+  }
+  return true;
+}
+
+// Clinger's fast path: decimal numbers with at most 19 significant digits,
+// a mantissa below 2^53 and a power of ten within [-22, 22] convert exactly
+// with one floating-point multiplication or division. Returns false for
+// everything else (which is left to strtod)
+inline bool parse_double_fast(const char *first, const char *last, double &result) {
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+  static const double powers_of_ten[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                         1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                         1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  bool negative = false;
+  if (first != last && (*first == '-' || *first == '+')) {
+    negative = (*first == '-');
+    ++first;
+  }
+
+  uint64_t mantissa = 0;
+  size_t digits = 0;
+  long exponent = 0;
+  if (!parse_digits(first, last, mantissa, digits))
+    return false;
+  if (first != last && *first == '.') {
+    const char *fraction = ++first;
+    if (!parse_digits(first, last, mantissa, digits))
+      return false;
+    exponent -= static_cast<long>(first - fraction);
+  }
+  if (digits == 0)
+    return false;
+
+  if (first != last && (*first == 'e' || *first == 'E')) {
+    ++first;
+    bool negative_exponent = false;
+    if (first != last && (*first == '-' || *first == '+')) {
+      negative_exponent = (*first == '-');
+      ++first;
+    }
+    if (first == last || last - first > 4)
+      return false;
+    long value = 0;
+    for (; first != last && is_digit(*first); ++first)
+      value = value * 10 + (*first - '0');
+    exponent += negative_exponent ? -value : value;
+  }
+
+  if (first != last || mantissa > (1ULL << 53) || exponent < -22 || exponent > 22)
+    return false;
+  double value = static_cast<double>(mantissa);
+  value = exponent < 0 ? value / powers_of_ten[-exponent] : value * powers_of_ten[exponent];
+  result = negative ? -value : value;
+  return true;
+#else
+  (void)(first), (void)(last), (void)(result);
+  return false;
+#endif
+}
+
+#if __CSV2_SWAR_DIGITS__
+// Checks eight bytes against a fixed layout of digits and separators in
+// one go: byte b is valid if b + add_low sets and b + add_high clears
+// the high bit, i.e., add_low = 0x80 - lowest and add_high = 0x7F - highest
+inline bool matches_layout(const char *first, uint64_t add_low, uint64_t add_high) {
+  uint64_t chunk;
+  memcpy(&chunk, first, 8);
+  const uint64_t high_bits = 0x8080808080808080ULL;
+  return ((chunk + add_low) & ~(chunk + add_high) & ~chunk & high_bits) == high_bits;
+}
+#endif
+
+// Checks characters against a layout where '9' stands for any digit
+inline bool matches_layout(const char *first, const char *layout, size_t length) {
+  for (size_t i = 0; i < length; ++i)
+    if (layout[i] == '9' ? !is_digit(first[i]) : first[i] != layout[i])
+      return false;
+  return true;
+}
+
+inline int two_digits(const char *first) { return (first[0] - '0') * 10 + (first[1] - '0'); }
+
+// Days since 1970-01-01 in the proleptic Gregorian calendar (H. Hinnant)
+inline int64_t days_from_civil(int64_t year, unsigned month, unsigned day) {
+  year -= month <= 2;
+  const int64_t era = (year >= 0 ? year : year - 399) / 400;
+  const unsigned year_of_era = static_cast<unsigned>(year - era * 400);
+  const unsigned day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  const unsigned day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + static_cast<int64_t>(day_of_era) - 719468;
+}
+
+inline unsigned days_in_month(int64_t year, unsigned month) {
+  static const unsigned char days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  const bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+  return days[month - 1] + unsigned(month == 2 && leap);
+}
+
+} // namespace detail
+
+// Set of tokens that mark a missing value, e.g., "", NA, NULL or \N
+// Tokens shorter than 8 bytes are packed, together with their length,
+// into one 64-bit word each, so that matching a short cell costs one
+// load and one integer compare per token
+class NullValues {
+  std::vector<uint64_t> short_tokens_;   // packed tokens shorter than 8 bytes
+  std::vector<std::string> long_tokens_; // everything else
+
+  static uint64_t pack_(const char *first, size_t length) {
+    char bytes[8] = {0};
+    memcpy(bytes, first, length);
+    bytes[7] = static_cast<char>(length);
+    uint64_t result;
+    memcpy(&result, bytes, 8);
+    return result;
+  }
+
+public:
+  NullValues() : NullValues({"", "NA", "NULL", "\\N"}) {}
+
+  NullValues(std::initializer_list<std::string> tokens) {
+    for (const auto &token : tokens) {
+      if (token.size() < 8)
+        short_tokens_.push_back(pack_(token.data(), token.size()));
+      else
+        long_tokens_.push_back(token);
+    }
+  }
+
+  // True if the (trimmed) cell characters [first, last) are a null token
+  bool contains(const char *first, const char *last) const {
+    const size_t length = last - first;
+    if (length < 8) {
+      const uint64_t packed = pack_(first, length);
+      for (const auto token : short_tokens_)
+        if (token == packed)
+          return true;
+      return false;
+    }
+    for (const auto &token : long_tokens_)
+      if (token.size() == length && memcmp(token.data(), first, length) == 0)
+        return true;
+    return false;
+  }
+};
+
+// Point in time as nanoseconds since 1970-01-01T00:00:00Z
+struct timestamp {
+  int64_t nanoseconds;
+};
+
+// Parses the (trimmed) cell characters [first, last) into `result`
+// Returns false if the characters do not form a valid value
+// Specialize csv2::convert<T> to read your own types from cells
+template <typename T, typename Enable = void> struct convert {
+  static_assert(!std::is_same<T, T>::value, "csv2::convert<T> is not specialized for this type");
+};
+
+template <typename T>
+struct convert<T, typename std::enable_if<std::is_integral<T>::value &&
+                                          !std::is_same<T, bool>::value>::type> {
+  static bool parse(const char *first, const char *last, T &result) {
+    typedef typename std::make_unsigned<T>::type unsigned_type;
+    bool negative = false;
+    if (first != last && (*first == '-' || *first == '+')) {
+      negative = (*first == '-');
+      ++first;
+    }
+    if (first == last || (negative && std::is_unsigned<T>::value))
+      return false;
+
+    const unsigned_type limit =
+        unsigned_type(std::numeric_limits<T>::max()) + unsigned_type(negative ? 1 : 0);
+    unsigned_type value = 0;
+    for (; first != last; ++first) {
+      const unsigned digit = static_cast<unsigned char>(*first) - unsigned('0');
+      if (digit > 9 || value > (limit - digit) / 10)
+        return false;
+      value = static_cast<unsigned_type>(value * 10 + digit);
+    }
+    if (negative && value != 0)
+      result = static_cast<T>(-static_cast<T>(value - 1) - 1);
+    else
+      result = static_cast<T>(value);
+    return true;
+  }
+};
+
+template <typename T>
+struct convert<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+  static bool parse(const char *first, const char *last, T &result) {
+    const size_t length = last - first;
+    if (length == 0)
+      return false;
+    if (parse_fast_(first, last, result))
+      return true;
+
+    // strtod et al. need a null-terminated input
+    char buffer[64];
+    std::string long_buffer;
+    const char *input = buffer;
+    if (length < sizeof(buffer)) {
+      memcpy(buffer, first, length);
+      buffer[length] = '\0';
+    } else {
+      long_buffer.assign(first, last);
+      input = long_buffer.c_str();
+    }
+
+    char *end = nullptr;
+    result = strto_(input, &end, static_cast<T *>(nullptr));
+    return end == input + length;
+  }
+
+private:
+  static bool parse_fast_(const char *first, const char *last, double &result) {
+    return detail::parse_double_fast(first, last, result);
+  }
+  template <typename U> static bool parse_fast_(const char *, const char *, U &) {
+    return false;
+  }
+
+  static float strto_(const char *input, char **end, float *) { return strtof(input, end); }
+  static double strto_(const char *input, char **end, double *) { return strtod(input, end); }
+  static long double strto_(const char *input, char **end, long double *) {
+    return strtold(input, end);
+  }
+};
+
+template <> struct convert<bool> {
+  static bool parse(const char *first, const char *last, bool &result) {
+    const size_t length = last - first;
+    if (length == 1 && (*first == '0' || *first == '1')) {
+      result = (*first == '1');
+      return true;
+    }
+    if (equals_(first, length, "true", 4) || equals_(first, length, "false", 5)) {
+      result = (length == 4);
+      return true;
+    }
+    return false;
+  }
+
+private:
+  // Case-insensitive comparison against a lowercase literal
+  static bool equals_(const char *first, size_t length, const char *literal, size_t n) {
+    if (length != n)
+      return false;
+    for (size_t i = 0; i < n; ++i)
+      if ((first[i] | 0x20) != literal[i])
+        return false;
+    return true;
+  }
+};
+
+// Parses YYYY-MM-DD[(T| )HH:MM[:SS[.fffffffff]]][Z|(+|-)hh[:mm]]
+// All fields sit at fixed offsets, so the date and the time of day are
+// each validated with a single eight-byte layout check
+template <> struct convert<timestamp> {
+  static bool parse(const char *first, const char *last, timestamp &result) {
+    const size_t length = last - first;
+    if (length < 10 || !date_(first))
+      return false;
+    const int64_t year = detail::two_digits(first) * 100 + detail::two_digits(first + 2);
+    const unsigned month = detail::two_digits(first + 5), day = detail::two_digits(first + 8);
+    if (month < 1 || month > 12 || day < 1 || day > detail::days_in_month(year, month))
+      return false;
+
+    int64_t seconds = detail::days_from_civil(year, month, day) * 86400, nanoseconds = 0;
+    const char *p = first + 10;
+    if (p != last) {
+      if ((*p != 'T' && *p != 't' && *p != ' ') || last - p < 6)
+        return false;
+      const char *time = p + 1;
+      int secs = 0;
+      if (last - p >= 9 && p[6] == ':') {
+        if (!time_(time))
+          return false;
+        secs = detail::two_digits(time + 6);
+        p += 9;
+      } else {
+        if (!detail::matches_layout(time, "99:99", 5))
+          return false;
+        p += 6;
+      }
+      const int hours = detail::two_digits(time), minutes = detail::two_digits(time + 3);
+      if (hours > 23 || minutes > 59 || secs > 59)
+        return false;
+      seconds += hours * 3600 + minutes * 60 + secs;
+
+      if (p != last && *p == '.') {
+        const char *fraction = ++p;
+        int64_t scale = 1000000000;
+        for (; p != last && detail::is_digit(*p); ++p)
+          if (scale > 1)
+            nanoseconds += (*p - '0') * (scale /= 10);
+        if (p == fraction)
+          return false;
+      }
+
+      if (p != last && (*p == 'Z' || *p == 'z')) {
+        ++p;
+      } else if (p != last && (*p == '+' || *p == '-')) {
+        const int64_t sign = (*p == '+') ? -1 : 1;
+        const size_t zone = last - p - 1;
+        if (zone == 2 && detail::matches_layout(p + 1, "99", 2))
+          seconds += sign * detail::two_digits(p + 1) * 3600;
+        else if (zone == 5 && detail::matches_layout(p + 1, "99:99", 5))
+          seconds += sign * (detail::two_digits(p + 1) * 3600 + detail::two_digits(p + 4) * 60);
+        else if (zone == 4 && detail::matches_layout(p + 1, "9999", 4))
+          seconds += sign * (detail::two_digits(p + 1) * 3600 + detail::two_digits(p + 3) * 60);
+        else
+          return false;
+        p = last;
+      }
+      if (p != last)
+        return false;
+    }
+    result.nanoseconds = seconds * 1000000000 + nanoseconds;
+    return true;
+  }
+
+private:
+  // YYYY-MM-DD
+  static bool date_(const char *first) {
+#if __CSV2_SWAR_DIGITS__
+    // "9999-99-": digits need [0x30, 0x39], dashes exactly 0x2D
+    return detail::matches_layout(first, 0x5350505350505050ULL, 0x5246465246464646ULL) &&
+           detail::is_digit(first[8]) && detail::is_digit(first[9]);
+#else
+    return detail::matches_layout(first, "9999-99-99", 10);
+#endif
+  }
+
+  // HH:MM:SS
+  static bool time_(const char *first) {
+#if __CSV2_SWAR_DIGITS__
+    // "99:99:99": digits need [0x30, 0x39], colons exactly 0x3A
+    return detail::matches_layout(first, 0x5050465050465050ULL, 0x4646454646454646ULL);
+#else
+    return detail::matches_layout(first, "99:99:99", 8);
+#endif
+  }
+};
+
+template <> struct convert<std::string> {
+  static bool parse(const char *first, const char *last, std::string &result) {
+    result.assign(first, last);
+    return true;
+  }
+};
+
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+template <> struct convert<std::string_view> {
+  static bool parse(const char *first, const char *last, std::string_view &result) {
+    result = std::string_view(first, last - first);
+    return true;
+  }
+};
+#endif
+
+} // namespace csv2
 
 #pragma once
+#include <cstddef>
 #include <utility>
 
 namespace csv2 {
@@ -1627,92 +2035,635 @@ template <bool flag> struct first_row_is_header {
   constexpr static bool value = flag;
 };
 
+// Lines starting with this character are skipped, '\0' disables comments
+template <char character> struct comment_character {
+  constexpr static char value = character;
+};
+
+// Number of leading lines to skip before the header (or the first row)
+template <size_t count> struct skip_rows {
+  constexpr static size_t value = count;
+};
+
+// Skip empty and whitespace-only lines while iterating over rows
+template <bool flag> struct ignore_empty_lines {
+  constexpr static bool value = flag;
+};
+
+// Allow line breaks inside quoted cells; rows then end at the first
+// line terminator outside quotes
+template <bool flag> struct quoted_newlines {
+  constexpr static bool value = flag;
+};
+
+}
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace csv2 {
+
+namespace detail {
+
+// Number of worker threads to use; 0 means one per hardware thread
+inline size_t thread_count(size_t threads) {
+  if (threads == 0)
+    threads = std::thread::hardware_concurrency();
+  return threads == 0 ? 1 : threads;
+}
+
+// Runs task(i) for every i in [0, tasks) on up to `threads` threads
+// Tasks are handed out one at a time through a shared counter, so
+// threads that finish early pick up the remaining work. The first
+// exception thrown by a task is rethrown on the calling thread
+template <class Task> void parallel_for(size_t tasks, size_t threads, Task task) {
+  std::atomic<size_t> next{0};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto worker = [&]() {
+    for (size_t i; (i = next.fetch_add(1)) < tasks;) {
+      try {
+        task(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error)
+          error = std::current_exception();
+      }
+    }
+  };
+
+  threads = std::min(thread_count(threads), tasks);
+  std::vector<std::thread> pool;
+  for (size_t i = 1; i < threads; ++i)
+    pool.emplace_back(worker);
+  worker();
+  for (auto &thread : pool)
+    thread.join();
+  if (error)
+    std::rethrow_exception(error);
+}
+
+// Runs task(worker, i) for every i in [0, tasks) on up to `threads`
+// threads with work stealing. Every worker owns a contiguous run of task
+// indices, packed as [begin, end) into one atomic word; it takes tasks from
+// the front of its own run and, once that is empty, steals single tasks from
+// the back of the others. The first exception thrown by a task is rethrown
+// on the calling thread
+template <class Task> void stealing_for(size_t tasks, size_t threads, Task task) {
+  threads = std::max<size_t>(1, std::min(thread_count(threads), tasks));
+  std::vector<std::atomic<uint64_t>> runs(threads);
+  for (size_t worker = 0; worker < threads; ++worker)
+    runs[worker] = (uint64_t(tasks * worker / threads) << 32) | (tasks * (worker + 1) / threads);
+
+  // take a task from the front (own run) or the back (stolen) of a run
+  auto take = [&](size_t run, bool front, size_t &task_index) {
+    uint64_t current = runs[run].load();
+    for (;;) {
+      const uint64_t begin = current >> 32, end = current & 0xFFFFFFFF;
+      if (begin >= end)
+        return false;
+      const uint64_t next = front ? ((begin + 1) << 32) | end : (begin << 32) | (end - 1);
+      if (runs[run].compare_exchange_weak(current, next)) {
+        task_index = static_cast<size_t>(front ? begin : end - 1);
+        return true;
+      }
+    }
+  };
+
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto worker = [&](size_t id) {
+    for (size_t i, victim = 0; victim < threads;) {
+      if (victim == 0 ? take(id, true, i) : take((id + victim) % threads, false, i)) {
+        try {
+          task(id, i);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(error_mutex);
+          if (!error)
+            error = std::current_exception();
+        }
+        victim = 0;
+      } else {
+        ++victim;
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (size_t i = 1; i < threads; ++i)
+    pool.emplace_back(worker, i);
+  worker(0);
+  for (auto &thread : pool)
+    thread.join();
+  if (error)
+    std::rethrow_exception(error);
+}
+
+} // namespace detail
+
 } // namespace csv2
 #pragma once
+#include <cstdint>
 #include <cstring>
-#if __has_include("sys/mman.h") ||                                                                 \
-                  __has_include(                                                                   \
-                      <sys/mman.h>) || __has_include("windows.h") || __has_include(<windows.h>)
-#define __CSV2_HAS_MMAN_H__ 1
-// #include <csv2/mio.hpp>
+// #include <csv2/parallel.hpp>
+#include <vector>
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) ||                              \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define __CSV2_HAS_SSE2__ 1
+#include <immintrin.h>
 #endif
-// #include <csv2/parameters.hpp>
-#include <istream>
-#include <string>
-#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
-#include <string_view>
+#if defined(_MSC_VER)
+#include <intrin.h>
 #endif
 
 namespace csv2 {
 
-template <class delimiter = delimiter<','>, class quote_character = quote_character<'"'>,
-          class first_row_is_header = first_row_is_header<true>,
-          class trim_policy = trim_policy::trim_whitespace>
-class Reader {
-#if __CSV2_HAS_MMAN_H__
-  mio::mmap_source mmap_;       // mmap source
+namespace detail {
+
+inline size_t popcount(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<size_t>(__builtin_popcountll(x));
+#elif defined(_MSC_VER) && defined(_M_X64)
+  return static_cast<size_t>(__popcnt64(x));
+#else
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return static_cast<size_t>((x * 0x0101010101010101ULL) >> 56);
 #endif
-  const char *buffer_{nullptr}; // pointer to memory-mapped data
-  size_t buffer_size_{0};       // mapped length of buffer
-  size_t header_start_{0};      // start index of header (cache)
-  size_t header_end_{0};        // end index of header (cache)
+}
 
-public:
-#if __CSV2_HAS_MMAN_H__
-  // Use this if you'd like to mmap the CSV file
-  template <typename StringType> bool mmap(StringType &&filename) {
-    mmap_ = mio::mmap_source(filename);
-    if (!mmap_.is_open() || !mmap_.is_mapped())
-      return false;
-    buffer_ = mmap_.data();
-    buffer_size_ = mmap_.mapped_length();
-    return true;
-  }
+inline size_t trailing_zeros(uint32_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<size_t>(__builtin_ctz(x));
+#elif defined(_MSC_VER)
+  unsigned long result;
+  _BitScanForward(&result, x);
+  return static_cast<size_t>(result);
+#else
+  size_t result = 0;
+  for (; (x & 1) == 0; x >>= 1)
+    ++result;
+  return result;
+#endif
+}
+
+inline size_t leading_zeros(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<size_t>(__builtin_clzll(x));
+#elif defined(_MSC_VER) && defined(_M_X64)
+  unsigned long result;
+  _BitScanReverse64(&result, x);
+  return static_cast<size_t>(63 - result);
+#else
+  size_t result = 0;
+  for (; (x & (uint64_t(1) << 63)) == 0; x <<= 1)
+    ++result;
+  return result;
 #endif
+}
 
-  // Use this if you have the CSV contents
-  // in an std::string already
-  template <typename StringType> bool parse(StringType &&contents) {
-    buffer_ = std::forward<StringType>(contents).c_str();
-    buffer_size_ = contents.size();
-    return buffer_size_ > 0;
+// Bit i is set if first[i] == c, for the 64 bytes at `first`
+inline uint64_t match_mask(const char *first, char c) {
+#if defined(__AVX2__)
+  const __m256i needle = _mm256_set1_epi8(c);
+  const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+  const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first + 32));
+  return uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, needle)))) |
+         (uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, needle)))) << 32);
+#elif __CSV2_HAS_SSE2__
+  const __m128i needle = _mm_set1_epi8(c);
+  uint64_t result = 0;
+  for (int i = 0; i < 4; ++i) {
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first + 16 * i));
+    result |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)))) << (16 * i);
   }
+  return result;
+#else
+  uint64_t result = 0;
+  for (int i = 0; i < 64; ++i)
+    result |= uint64_t(first[i] == c) << i;
+  return result;
+#endif
+}
 
+// Bit i is set if an odd number of bits in [0, i] are set, i.e., with
+// a quote mask as input, the bits inside (and opening) quoted sections
+inline uint64_t prefix_xor(uint64_t x) {
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+}
 
-  // Use this if you have the CSV contents
-  // in an std::string_view already
-#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
-  bool parse_view(std::string_view sv) {
-    buffer_ = sv.data();
-    buffer_size_ = sv.size();
-    return buffer_size_ > 0;
+// Returns the last occurrence of `c` in [first, last), or nullptr; uses
+// memrchr where available, else compares 64 bytes at a time from the end
+inline const char *find_last(const char *first, const char *last, char c) {
+#if defined(__GLIBC__) && defined(_GNU_SOURCE)
+  return static_cast<const char *>(memrchr(first, c, last - first));
+#else
+  while (last - first >= 64) {
+    last -= 64;
+    if (const uint64_t mask = match_mask(last, c))
+      return last + 63 - leading_zeros(mask);
+  }
+  while (last != first) {
+    if (*--last == c)
+      return last;
   }
+  return nullptr;
 #endif
+}
 
+// Returns the first occurrence of [needle, needle + length) in [first, last),
+// or nullptr. Candidates are found by comparing the first and the last byte
+// of the needle at 32 (AVX2) or 16 (SSE2) positions at a time, and confirmed
+// with memcmp
+inline const char *find(const char *first, const char *last, const char *needle, size_t length) {
+  if (length == 0)
+    return first;
+  if (static_cast<size_t>(last - first) < length)
+    return nullptr;
+  if (length == 1)
+    return static_cast<const char *>(memchr(first, *needle, last - first));
+
+  const char *end = last - length + 1; // candidates start in [first, end)
+#if defined(__AVX2__)
+  const __m256i head = _mm256_set1_epi8(needle[0]), tail = _mm256_set1_epi8(needle[length - 1]);
+  for (; end - first >= 32; first += 32) {
+    const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+    const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first + length - 1));
+    uint32_t mask = uint32_t(
+        _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, head), _mm256_cmpeq_epi8(b, tail))));
+    for (; mask != 0; mask &= mask - 1) {
+      const char *candidate = first + trailing_zeros(mask);
+      if (memcmp(candidate + 1, needle + 1, length - 2) == 0)
+        return candidate;
+    }
+  }
+#elif __CSV2_HAS_SSE2__
+  const __m128i head = _mm_set1_epi8(needle[0]), tail = _mm_set1_epi8(needle[length - 1]);
+  for (; end - first >= 16; first += 16) {
+    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first + length - 1));
+    uint32_t mask =
+        uint32_t(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, head), _mm_cmpeq_epi8(b, tail))));
+    for (; mask != 0; mask &= mask - 1) {
+      const char *candidate = first + trailing_zeros(mask);
+      if (memcmp(candidate + 1, needle + 1, length - 2) == 0)
+        return candidate;
+    }
+  }
+#endif
+  for (; first < end; ++first) {
+    if (*first == needle[0] && first[length - 1] == needle[length - 1] &&
+        memcmp(first + 1, needle + 1, length - 2) == 0)
+      return first;
+  }
+  return nullptr;
+}
 
-  class RowIterator;
-  class Row;
-  class CellIterator;
+// Number of occurrences of `c` in [first, first + length), 64 bytes at a time
+inline size_t count(const char *first, size_t length, char c) {
+  size_t result = 0, i = 0;
+  for (; length - i >= 64; i += 64)
+    result += popcount(match_mask(first + i, c));
+  for (; i < length; ++i)
+    result += first[i] == c;
+  return result;
+}
 
-  class Cell {
-    const char *buffer_{nullptr}; // Pointer to memory-mapped buffer
-    size_t start_{0};             // Start index of cell content
-    size_t end_{0};               // End index of cell content
-    bool escaped_{false};         // Does the cell have escaped content?
-    friend class Row;
-    friend class CellIterator;
+struct line_count {
+  size_t outside; // line terminators outside quotes, if the range starts outside
+  size_t total;   // all line terminators
+  bool odd;       // odd number of quote characters?
+};
 
-  public:
-// returns a view on the cell's contents if C++17 available
-#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
-    std::string_view read_view() const {
-      const auto new_start_end = trim_policy::trim(buffer_, start_, end_);
-      return std::string_view(buffer_ + new_start_end.first,
-                              new_start_end.second - new_start_end.first);
+// Counts the line terminators in [first, first + length), 64 bytes at a
+// time with a vector compare and popcount. If `quoted`, terminators inside
+// quoted sections are told apart through the prefix-XOR of the quote mask
+inline line_count count_lines(const char *first, size_t length, char newline, char quote,
+                              bool quoted) {
+  line_count result{0, 0, false};
+  uint64_t inside = 0; // all ones while in a quoted section
+  char tail[64], padding = '\0';
+  while (padding == newline || padding == quote)
+    ++padding;
+  for (size_t i = 0; i < length; i += 64) {
+    const char *block = first + i;
+    if (length - i < 64) {
+      memset(tail, padding, sizeof(tail));
+      memcpy(tail, block, length - i);
+      block = tail;
     }
-#endif
-    // Returns the raw_value of the cell without handling escaped
-    // content, e.g., cell containing """foo""" will be returned
+    const uint64_t lines = match_mask(block, newline);
+    result.total += popcount(lines);
+    if (quoted) {
+      const uint64_t quotes = prefix_xor(match_mask(block, quote)) ^ inside;
+      result.outside += popcount(lines & ~quotes);
+      inside = uint64_t(0) - (quotes >> 63);
+    }
+  }
+  result.outside = quoted ? result.outside : result.total;
+  result.odd = inside != 0;
+  return result;
+}
+
+// Same as count_lines, but splits buffers of `threshold` bytes or more
+// over `threads` threads (0 = one per hardware thread); returns the number
+// of terminators outside quotes
+inline size_t count_lines_parallel(const char *first, size_t length, char newline, char quote,
+                                   bool quoted, size_t threshold = size_t(64) << 20,
+                                   size_t threads = 0) {
+  threads = length < threshold ? 1 : thread_count(threads);
+  if (threads == 1 || length == 0)
+    return count_lines(first, length, newline, quote, quoted).outside;
+
+  // chunks start on 64-byte boundaries and together cover all of the buffer
+  const size_t chunks = threads * 4, chunk_size = ((length + chunks - 1) / chunks + 63) / 64 * 64;
+  std::vector<line_count> counts(chunks);
+  parallel_for(chunks, threads, [&](size_t chunk) {
+    const size_t begin = std::min(length, chunk * chunk_size);
+    const size_t end = std::min(length, begin + chunk_size);
+    counts[chunk] = count_lines(first + begin, end - begin, newline, quote, quoted);
+  });
+
+  // a chunk that starts inside quotes sees the complement of its quote mask
+  size_t result = 0;
+  bool inside = false;
+  for (const auto &count : counts) {
+    result += inside ? count.total - count.outside : count.outside;
+    inside = inside != count.odd;
+  }
+  return result;
+}
+
+} // namespace detail
+
+} // namespace csv2
+
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#if __has_include("sys/mman.h") || __has_include(<sys/mman.h>) || __has_include("windows.h") || __has_include(<windows.h>)
+#define __CSV2_HAS_MMAN_H__ 1
+// #include <csv2/mio.hpp>
+#endif
+// #include <csv2/convert.hpp>
+// #include <csv2/parameters.hpp>
+// #include <csv2/scan.hpp>
+#include <fstream>
+#include <istream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+	#include <string_view>
+#endif
+
+namespace csv2 {
+
+// Result of Reader::estimate_rows(); [lower, upper] is a 95% confidence
+// interval around `rows`, and collapses onto it if the count is exact
+struct RowEstimate {
+  size_t rows;
+  size_t lower;
+  size_t upper;
+  bool exact;
+};
+
+// How Reader::filter compares a cell with the given value
+enum class match { equals, prefix, contains };
+
+template <class Reader> std::vector<size_t> split_points(const Reader &reader, size_t count);
+template <class Reader>
+std::vector<typename Reader::Row> sample(const Reader &reader, size_t count, uint64_t seed);
+
+template <class delimiter = delimiter<','>, class quote_character = quote_character<'"'>,
+          class first_row_is_header = first_row_is_header<true>,
+          class trim_policy = trim_policy::trim_whitespace,
+          class comment_character = comment_character<'\0'>, class skip_rows = skip_rows<0>,
+          class ignore_empty_lines = ignore_empty_lines<false>,
+          class quoted_newlines = quoted_newlines<false>>
+class Reader {
+  #if __CSV2_HAS_MMAN_H__
+  mio::mmap_source mmap_;          // mmap source
+  #endif
+  const char *buffer_{nullptr};    // pointer to memory-mapped data
+  size_t buffer_size_{0};          // mapped length of buffer
+  size_t header_start_{0};         // start index of header (cache)
+  size_t header_end_{0};           // end index of header (cache)
+  size_t rows_start_{0};           // start index of the row after the header (cache)
+  size_t first_row_{0};            // start index of the first row visited by begin()
+  const char *header_buffer_{nullptr}; // buffer holding the header, buffer_ unless
+                                       // a chunk of a file is mapped
+  char newline_{'\n'};             // line terminator, '\r' for CR-only files
+  bool crlf_{false};               // do lines end with "\r\n"?
+  size_t limit_{0};                // maximum number of rows, 0 = all
+  size_t truncated_{0};            // after the limit_-th row's terminator, 0 = not truncated
+  #if __CSV2_HAS_MMAN_H__
+  bool complete_rows_{false};      // end mmap'ed buffers at the last line terminator?
+  std::string path_;               // mmap'ed file, for follow()
+  mio::mmap_source follow_mmap_;   // region appended since the last follow()
+  size_t followed_{0};             // file offset up to which rows were delivered
+  mio::mmap_source header_mmap_;   // start of the file, if a chunk is mapped
+  #endif
+
+public:
+  #if __CSV2_HAS_MMAN_H__
+  // Use this if you'd like to mmap the CSV file
+  // With limit(n), only the first pages of the file, up to the end of the
+  // n-th row, are mapped
+  template <typename StringType> bool mmap(StringType &&filename) {
+    path_ = filename;
+    if (limit_ > 0) {
+      if (!mmap_head_(filename))
+        return false;
+    } else {
+      mmap_ = mio::mmap_source(filename);
+      if (!mmap_.is_open() || !mmap_.is_mapped())
+        return false;
+      buffer_ = mmap_.data();
+      buffer_size_ = mmap_.mapped_length();
+      index_();
+    }
+    followed_ = complete_end_();
+    if (complete_rows_)
+      buffer_size_ = std::min(buffer_size_, followed_);
+    return true;
+  }
+
+  // Use this to mmap only the bytes [offset, offset + length) of the file,
+  // e.g., one of the chunks from csv2::split_points; `offset` must be a row
+  // boundary. The header is read from the start of the file, mapping only
+  // the pages up to its end. Row offsets are relative to `offset`
+  template <typename StringType> bool mmap(StringType &&filename, size_t offset, size_t length) {
+    path_ = filename;
+    const size_t file_size = file_size_(filename);
+    if (offset >= file_size)
+      return false;
+    length = std::min(length, file_size - offset);
+    std::error_code error;
+    if (offset > 0) {
+      // the header, from a growing prefix of the file
+      for (size_t prefix = size_t(4) << 10;; prefix *= 2) {
+        prefix = std::min(prefix, file_size);
+        mmap_.map(filename, 0, prefix, error);
+        if (error)
+          return false;
+        buffer_ = mmap_.data();
+        buffer_size_ = mmap_.mapped_length();
+        index_();
+        if (rows_start_ <= buffer_size_ || prefix == file_size)
+          break;
+      }
+      header_mmap_ = std::move(mmap_);
+    }
+    mmap_.map(filename, offset, length, error);
+    if (error)
+      return false;
+    buffer_ = mmap_.data();
+    buffer_size_ = mmap_.length();
+    if (offset > 0)
+      first_row_ = 0;
+    else
+      index_();
+    truncate_();
+    followed_ = complete_end_();
+    if (complete_rows_)
+      buffer_size_ = std::min(buffer_size_, followed_);
+    followed_ += offset;
+    return true;
+  }
+
+  // Follow mode (tail -f): calls `callback(row)` for each complete row
+  // appended to the mmap'ed file since mmap() or the last follow() call, and
+  // returns the number of rows delivered. Only the new region of the file is
+  // mapped; a row without its line terminator yet is delivered by a later
+  // call, once complete; so is the header, if its line was incomplete at
+  // mmap(). Use complete_rows(true) so that iteration does not also yield
+  // such a partial last line. Delivered rows are valid until the next call;
+  // their offset() is relative to the new region, which starts at the file
+  // offset followed() returned before the call. See FileWatcher
+  // (csv2/follow.hpp) to wait for appends
+  template <typename Function> size_t follow(Function &&callback) {
+    const size_t size = file_size_(path_);
+    if (size <= followed_)
+      return 0;
+    std::error_code error;
+    if (first_row_is_header::value && rows_start_ > buffer_size_) {
+      // the header line was incomplete when mapped: index it again, the
+      // rows start after it
+      mmap_.map(path_, error);
+      if (error)
+        return 0;
+      buffer_ = mmap_.data();
+      buffer_size_ = mmap_.mapped_length();
+      index_();
+      if (rows_start_ > buffer_size_)
+        return 0;
+      // the rows are delivered below, not by iteration
+      followed_ = buffer_size_ = rows_start_;
+      if (size <= followed_)
+        return 0;
+    }
+    follow_mmap_.map(path_, followed_, size - followed_, error);
+    if (error)
+      return 0;
+
+    const char *region = follow_mmap_.data();
+    const size_t length = follow_mmap_.length();
+    size_t result{0}, start{0};
+    for (size_t end; (end = row_end_(region, length, newline_, start)) < length; start = end + 1) {
+      if (comment_line_(region + start, region + end) or
+          (ignore_empty_lines::value and blank_line_(region + start, region + end)))
+        continue;
+      callback(row_(region, start, end));
+      ++result;
+    }
+    followed_ += start;
+    return result;
+  }
+  #endif
+
+  // Limits the following mmap() and parse() calls to the first `rows` rows
+  // (after the header), e.g., to preview a large file; 0 removes the limit
+  void limit(size_t rows) { limit_ = rows; }
+
+  #if __CSV2_HAS_MMAN_H__
+  // Ends the buffers of the following mmap() calls at the last line
+  // terminator, leaving out an incomplete last line, e.g., for a file that
+  // is still being written: iteration then ends where follow() picks up
+  void complete_rows(bool flag) { complete_rows_ = flag; }
+
+  // File offset up to which rows were delivered, where the next follow()
+  // call picks up
+  size_t followed() const { return followed_; }
+  #endif
+
+  // Use this if you have the CSV contents
+  // in an std::string already
+  template <typename StringType> bool parse(StringType &&contents) {
+    buffer_ = std::forward<StringType>(contents).c_str();
+    buffer_size_ = contents.size();
+    index_();
+    truncate_();
+    return buffer_size_ > 0;
+  }
+
+
+  // Use this if you already have the CSV contents
+  // in a std::string_view 
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+  bool parse_view(std::string_view sv) {
+    buffer_ = sv.data();
+    buffer_size_ = sv.size();
+    index_();
+    truncate_();
+    return buffer_size_ > 0;
+  }
+#endif
+
+
+  class RowIterator;
+  class Row;
+  class CellIterator;
+
+  class Cell {
+    const char *buffer_{nullptr}; // Pointer to memory-mapped buffer
+    size_t start_{0};             // Start index of cell content
+    size_t end_{0};               // End index of cell content
+    bool escaped_{false};         // Does the cell have escaped content?
+    friend class Reader;
+    friend class Row;
+    friend class CellIterator;
+
+  public:
+  
+	// returns a view on the cell's contents if C++17 available
+	#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+      std::string_view read_view() const {
+      const auto new_start_end = trim_policy::trim(buffer_, start_, end_);
+      return std::string_view(buffer_ + new_start_end.first, new_start_end.second- new_start_end.first);
+      }
+	#endif
+    // Returns the raw_value of the cell without handling escaped
+    // content, e.g., cell containing """foo""" will be returned
     // as is
     template <typename Container> void read_raw_value(Container &result) const {
       if (start_ >= end_)
@@ -1737,18 +2688,65 @@ public:
         }
       }
     }
+
+    // True if the (trimmed, unquoted) cell contents are one of the null tokens
+    bool is_null(const NullValues &nulls) const {
+      const auto span = unquoted_(*this);
+      return nulls.contains(buffer_ + span.first, buffer_ + span.second);
+    }
+
+    // Converts the trimmed cell contents, without enclosing quotes, with
+    // csv2::convert<T>, so "1" and 1 are the same integer
+    // Returns false if the contents are not a valid T
+    template <typename T> bool get(T &result) const {
+      const auto span = unquoted_(*this);
+      return get_(buffer_ + span.first, buffer_ + span.second, result);
+    }
+
+    // Same as above, but throws std::invalid_argument on failure
+    template <typename T> T get() const {
+      T result{};
+      if (!get(result)) {
+        std::string value;
+        read_raw_value(value);
+        throw std::invalid_argument("csv2: cannot convert cell value \"" + value + "\"");
+      }
+      return result;
+    }
+
+  private:
+    template <typename T> bool get_(const char *first, const char *last, T &result) const {
+      return convert<T>::parse(first, last, result);
+    }
+
+    // Strings unescape doubled quote characters
+    bool get_(const char *first, const char *last, std::string &result) const {
+      const char quote = quote_character::value;
+      result.clear();
+      result.reserve(last - first);
+      for (; first != last; ++first) {
+        result.push_back(*first);
+        if (*first == quote && first + 1 != last && first[1] == quote)
+          ++first;
+      }
+      return true;
+    }
   };
 
   class Row {
-    const char *buffer_{nullptr}; // Pointer to memory-mapped buffer
-    size_t start_{0};             // Start index of row content
-    size_t end_{0};               // End index of row content
+    const Reader *reader_{nullptr}; // Reader that produced this row
+    const char *buffer_{nullptr};   // Pointer to memory-mapped buffer
+    size_t start_{0};               // Start index of row content
+    size_t end_{0};                 // End index of row content
     friend class RowIterator;
     friend class Reader;
 
   public:
     // address of row
-    const char *address() const { return buffer_; }
+    const char *address() const { return buffer_ + start_; }
+    // byte offset of the row in the buffer, e.g., a checkpoint to resume
+    // from with Reader::begin(offset)
+    size_t offset() const { return start_; }
 	// returns the char length of the row
 	size_t length() const { return end_ - start_; }
 
@@ -1819,176 +2817,2232 @@ public:
 
     CellIterator begin() const { return CellIterator(buffer_, end_ - start_, start_, end_); }
     CellIterator end() const { return CellIterator(buffer_, end_ - start_, end_, end_); }
+
+    // Returns the cell at column `index`, or an empty cell
+    // if the row has fewer columns
+    Cell get(size_t index) const {
+      for (auto it = begin(), last = end(); it != last; ++it) {
+        const Cell cell = *it;
+        if (index-- == 0)
+          return cell;
+      }
+      return Cell();
+    }
+
+    // Other integer types, so that get(0) does not also match get(const char *)
+    template <typename Index>
+    typename std::enable_if<std::is_integral<Index>::value, Cell>::type get(Index index) const {
+      return get(static_cast<size_t>(index));
+    }
+
+    // Returns the cell under the header column `name`, see
+    // Reader::column_index
+    Cell get(const char *name) const { return get_(reader_->column_index(name)); }
+    Cell get(const std::string &name) const { return get_(reader_->column_index(name)); }
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+    Cell get(std::string_view name) const { return get_(reader_->column_index(name)); }
+#endif
+
+    // Returns the cells at the given (compile-time) columns; tokenization
+    // stops after the last selected column
+    template <size_t... columns> std::array<Cell, sizeof...(columns)> select() const {
+      const size_t indices[] = {columns...};
+      std::array<Cell, sizeof...(columns)> result;
+      size_t column = 0;
+      for (auto it = begin(), last = end();
+           it != last && column <= last_column_(columns...); ++it, ++column) {
+        const Cell cell = *it;
+        for (size_t i = 0; i < sizeof...(columns); ++i)
+          if (indices[i] == column)
+            result[i] = cell;
+      }
+      return result;
+    }
+
+    // Parses the leading cells of the row into a tuple, in one pass,
+    // e.g., row.as<int64_t, double, std::string>()
+    // Throws std::invalid_argument if a cell cannot be converted
+    template <class... Types> std::tuple<Types...> as() const {
+      std::tuple<Types...> result;
+      auto it = begin();
+      auto last = end();
+      read_tuple_<0>(it, last, result);
+      return result;
+    }
+
+    // Parses the leading cells of the row into the given members
+    // of an aggregate, e.g., row.into<Trade>(&Trade::id, &Trade::price)
+    // Throws std::invalid_argument if a cell cannot be converted
+    template <class T, class... Fields> T into(Fields T::*... fields) const {
+      return into_<T>(std::make_tuple(fields...));
+    }
+
+  private:
+    friend class Reader;
+
+    Cell get_(size_t index) const { return index == std::string::npos ? Cell() : get(index); }
+
+    static Cell next_cell_(CellIterator &it, CellIterator &last) {
+      if (!(it != last))
+        return Cell();
+      const Cell cell = *it;
+      ++it;
+      return cell;
+    }
+
+    template <size_t I, class Tuple>
+    typename std::enable_if<(I == std::tuple_size<Tuple>::value)>::type
+    read_tuple_(CellIterator &, CellIterator &, Tuple &) const {}
+
+    template <size_t I, class Tuple>
+    typename std::enable_if<(I < std::tuple_size<Tuple>::value)>::type
+    read_tuple_(CellIterator &it, CellIterator &last, Tuple &result) const {
+      std::get<I>(result) =
+          next_cell_(it, last).template get<typename std::tuple_element<I, Tuple>::type>();
+      read_tuple_<I + 1>(it, last, result);
+    }
+
+    template <class T, class Tuple> T into_(const Tuple &fields) const {
+      T result{};
+      auto it = begin();
+      auto last = end();
+      read_fields_<0>(it, last, result, fields);
+      return result;
+    }
+
+    template <size_t I, class T, class Tuple>
+    typename std::enable_if<(I == std::tuple_size<Tuple>::value)>::type
+    read_fields_(CellIterator &, CellIterator &, T &, const Tuple &) const {}
+
+    template <size_t I, class T, class Tuple>
+    typename std::enable_if<(I < std::tuple_size<Tuple>::value)>::type
+    read_fields_(CellIterator &it, CellIterator &last, T &result, const Tuple &fields) const {
+      const auto field = std::get<I>(fields);
+      typedef typename std::remove_reference<decltype(result.*field)>::type Field;
+      result.*field = next_cell_(it, last).template get<Field>();
+      read_fields_<I + 1>(it, last, result, fields);
+    }
   };
 
   class RowIterator {
     friend class Reader;
+    const Reader *reader_;
     const char *buffer_;
     size_t buffer_size_;
     size_t start_;
     size_t end_;
+    char newline_;
+    bool crlf_;
 
   public:
-    RowIterator(const char *buffer, size_t buffer_size, size_t start)
-        : buffer_(buffer), buffer_size_(buffer_size), start_(start), end_(start_) {}
+    RowIterator(const char *buffer, size_t buffer_size, size_t start,
+                const Reader *reader = nullptr)
+        : reader_(reader), buffer_(buffer), buffer_size_(buffer_size), start_(start),
+          end_(start_), newline_(reader ? reader->newline_ : '\n'),
+          crlf_(reader ? reader->crlf_ : false) {
+      skip_();
+    }
 
     RowIterator &operator++() {
       start_ = end_ + 1;
+      skip_();
       end_ = start_;
       return *this;
     }
 
     Row operator*() {
       Row result;
+      result.reader_ = reader_;
       result.buffer_ = buffer_;
       result.start_ = start_;
       result.end_ = end_;
 
-      if (const char *ptr =
-              static_cast<const char *>(memchr(&buffer_[start_], '\n', (buffer_size_ - start_)))) {
-        end_ = start_ + (ptr - &buffer_[start_]);
-        result.end_ = end_;
+      end_ = row_end_(buffer_, buffer_size_, newline_, start_);
+      result.end_ = end_;
+      if (end_ < buffer_size_)
         start_ = end_ + 1;
-      } else {
-        // last row
-        end_ = buffer_size_;
-        result.end_ = end_;
-      }
+      // drop the '\r' of a "\r\n" line ending
+      if (crlf_ && result.end_ > result.start_ && buffer_[result.end_ - 1] == '\r')
+        result.end_ -= 1;
       return result;
     }
 
     bool operator!=(const RowIterator &rhs) { return start_ != rhs.start_; }
+
+  private:
+    // Moves past skipped lines, so that the iterator always rests
+    // on a row that will be returned
+    void skip_() { start_ = skip_lines_(buffer_, buffer_size_, newline_, start_); }
   };
 
   RowIterator begin() const {
     if (buffer_size_ == 0)
       return end();
-    if (first_row_is_header::value) {
-      const auto header_indices = header_indices_();
-      return RowIterator(buffer_, buffer_size_,
-                         header_indices.second > 0 ? header_indices.second + 1 : 0);
-    } else {
-      return RowIterator(buffer_, buffer_size_, 0);
-    }
+    return RowIterator(buffer_, buffer_size_, first_row_, this);
+  }
+
+  RowIterator end() const { return RowIterator(buffer_, buffer_size_, buffer_size_ + 1, this); }
+
+  // Iterator starting at the first row boundary at or after `offset`
+  // Iterating from begin(a) to begin(b) visits the rows starting in
+  // [a, b), which makes it easy to split the buffer into chunks, and
+  // begin(row.offset()) resumes iteration at a checkpointed row
+  // With quoted_newlines, whether `offset` lies inside a quoted cell is
+  // derived from the parity of the quote characters after it (the buffer
+  // must end outside quotes), so the cost is proportional to the remaining
+  // bytes
+  RowIterator begin(size_t offset) const {
+    const RowIterator first = begin();
+    if (offset <= first.start_)
+      return first;
+    if (offset > buffer_size_)
+      return end();
+    if (quoted_newlines::value)
+      return RowIterator(buffer_, buffer_size_, resync_(offset), this);
+    if (buffer_[offset - 1] == newline_)
+      return RowIterator(buffer_, buffer_size_, offset, this);
+    if (const char *ptr =
+            static_cast<const char *>(memchr(&buffer_[offset], newline_, buffer_size_ - offset)))
+      return RowIterator(buffer_, buffer_size_, (ptr - buffer_) + 1, this);
+    return end();
   }
 
-  RowIterator end() const { return RowIterator(buffer_, buffer_size_, buffer_size_ + 1); }
+  // Raw access to the mapped/parsed buffer
+  const char *data() const { return buffer_; }
+  size_t size() const { return buffer_size_; }
 
-private:
-  std::pair<size_t, size_t> header_indices_() const {
-    size_t start = 0, end = 0;
+  // Range over the rows that yields function(row) for every row
+  template <class Function> class RowRange {
+    const Reader *reader_;
+    Function function_;
 
-    if (const char *ptr =
-            static_cast<const char *>(memchr(&buffer_[start], '\n', (buffer_size_ - start)))) {
-      end = start + (ptr - &buffer_[start]);
+  public:
+    class iterator {
+      RowIterator row_;
+      Function function_;
+
+    public:
+      iterator(RowIterator row, Function function) : row_(row), function_(function) {}
+
+      iterator &operator++() {
+        ++row_;
+        return *this;
+      }
+
+      auto operator*() -> decltype(std::declval<Function &>()(std::declval<Row>())) {
+        return function_(*row_);
+      }
+
+      bool operator!=(const iterator &rhs) { return row_ != rhs.row_; }
+    };
+
+    RowRange(const Reader *reader, Function function) : reader_(reader), function_(function) {}
+    iterator begin() const { return iterator(reader_->begin(), function_); }
+    iterator end() const { return iterator(reader_->end(), function_); }
+  };
+
+  template <size_t... columns> struct ColumnSelector {
+    std::array<Cell, sizeof...(columns)> operator()(const Row &row) const {
+      return row.template select<columns...>();
     }
-    return {start, end};
+  };
+
+  template <class... Types> struct TupleParser {
+    std::tuple<Types...> operator()(const Row &row) const {
+      return row.template as<Types...>();
+    }
+  };
+
+  template <class T, class... Fields> struct FieldParser {
+    std::tuple<Fields T::*...> fields;
+    T operator()(const Row &row) const { return row.template into_<T>(fields); }
+  };
+
+  // Iterate over rows as std::array<Cell, N> of the given columns,
+  // e.g., for (auto cells : csv.select<0, 3, 5>()) { ... }
+  template <size_t... columns> RowRange<ColumnSelector<columns...>> select() const {
+    static_assert(sizeof...(columns) > 0, "select requires at least one column");
+    return RowRange<ColumnSelector<columns...>>(this, ColumnSelector<columns...>());
   }
 
-public:
-  Row header() const {
-    size_t start = 0, end = 0;
-    Row result;
-    result.buffer_ = buffer_;
-    result.start_ = start;
-    result.end_ = end;
+  // Iterate over rows as std::tuple<Types...>, see Row::as
+  template <class... Types> RowRange<TupleParser<Types...>> as() const {
+    return RowRange<TupleParser<Types...>>(this, TupleParser<Types...>());
+  }
 
-    if (const char *ptr =
-            static_cast<const char *>(memchr(&buffer_[start], '\n', (buffer_size_ - start)))) {
-      end = start + (ptr - &buffer_[start]);
-      result.end_ = end;
-    }
-    return result;
+  // Iterate over rows as aggregates of type T, see Row::into
+  template <class T, class... Fields>
+  RowRange<FieldParser<T, Fields...>> into(Fields T::*... fields) const {
+    return RowRange<FieldParser<T, Fields...>>(this, FieldParser<T, Fields...>{
+                                                         std::make_tuple(fields...)});
   }
 
   /**
-   * @returns The number of rows (excluding the header)
+   * @returns The last `n` rows visited by begin()..end(), in order. The
+   * buffer is scanned backwards from its end, so only the bytes of those
+   * rows are read. With quoted_newlines, a line terminator ends a row if an
+   * even number of quote characters follows it (the buffer must end outside
+   * quotes). Unlike iteration, the empty row after a trailing line
+   * terminator is not returned, so tail(1) is the last line of a log
   */
-  size_t rows(bool ignore_empty_lines = false) const {
-    size_t result{0};
-    if (!buffer_ || buffer_size_ == 0)
+  std::vector<Row> tail(size_t n) const {
+    std::vector<Row> result;
+    if (!buffer_ || n == 0)
+      return result;
+    const size_t first = begin().start_;
+    if (first > buffer_size_)
       return result;
-    
-    // Count the first row if not header
-    if (not first_row_is_header::value
-        and (not ignore_empty_lines
-        or *(static_cast<const char*>(buffer_)) != '\r'))
-      ++result;
 
-    for (const char *p = buffer_
-        ; (p = static_cast<const char *>(memchr(p, '\n', (buffer_ + buffer_size_) - p)))
-        ; ++p) {
-      if (ignore_empty_lines
-          and (p >= buffer_ + buffer_size_ - 1
-          or *(p + 1) == '\r'))
+    bool odd = false; // odd number of quote characters after `position`?
+    for (size_t position = buffer_size_, end = buffer_size_; result.size() < n;) {
+      const char *found = detail::find_last(buffer_ + first, buffer_ + position, newline_);
+      const size_t start = found ? found - buffer_ + 1 : first;
+      if (quoted_newlines::value)
+        odd = odd != odd_quotes_(buffer_ + start, buffer_ + position);
+      if (found && odd) {
+        // inside a quoted cell, keep looking for the start of the row
+        position = start - 1;
         continue;
-      ++result;
+      }
+      // skips the empty row after a trailing line terminator
+      if (start < buffer_size_ and not comment_line_(buffer_ + start, buffer_ + end) and
+          (not ignore_empty_lines::value or not blank_line_(buffer_ + start, buffer_ + end)))
+        result.push_back(row_(start, end));
+      if (not found)
+        break;
+      position = end = start - 1;
     }
+    std::reverse(result.begin(), result.end());
     return result;
   }
 
-  size_t cols() const {
-    size_t result{0};
-    for (const auto cell : header())
-      result += 1;
-    return result;
-  }
-};
-} // namespace csv2
+  // Block of consecutive rows, tokenized in bulk into a structure of
+  // arrays: the offsets of every row and the spans of their cells, so
+  // that consumers can run tight loops over whole blocks, see batches()
+  class RowBatch {
+    friend class Reader;
+    const Reader *reader_{nullptr};
+    const char *buffer_{nullptr};
+    std::vector<size_t> row_starts_; // start offset of row i
+    std::vector<size_t> row_ends_;   // end offset of row i
+    std::vector<size_t> cell_index_; // cells of row i: [cell_index_[i], cell_index_[i + 1])
+    std::vector<size_t> cell_starts_;
+    std::vector<size_t> cell_ends_;
+    std::vector<char> cell_escaped_;
+
+    void clear_() {
+      row_starts_.clear();
+      row_ends_.clear();
+      cell_index_.assign(1, 0);
+      cell_starts_.clear();
+      cell_ends_.clear();
+      cell_escaped_.clear();
+    }
 
-#pragma once
-#include <cstring>
-// #include <csv2/parameters.hpp>
-#include <fstream>
-#include <iostream>
-#include <iterator>
-#include <string>
-#include <utility>
+    void push_(const Row &row) {
+      row_starts_.push_back(row.start_);
+      row_ends_.push_back(row.end_);
+      for (auto it = row.begin(), last = row.end(); it != last; ++it) {
+        const Cell cell = *it;
+        cell_starts_.push_back(cell.start_);
+        cell_ends_.push_back(cell.end_);
+        cell_escaped_.push_back(cell.escaped_);
+      }
+      cell_index_.push_back(cell_starts_.size());
+    }
 
-namespace csv2 {
+  public:
+    // Number of rows in the batch
+    size_t size() const { return row_starts_.size(); }
 
-template <typename, typename T> struct has_close : std::false_type {};
+    Row row(size_t i) const { return reader_->row_(buffer_, row_starts_[i], row_ends_[i]); }
 
-template <typename C, typename Ret, typename... Args> struct has_close<C, Ret(Args...)> {
-private:
-  template <typename T>
-  static constexpr auto check(T *) ->
-      typename std::is_same<decltype(std::declval<T>().close(std::declval<Args>()...)), Ret>::type;
+    // Number of cells in row i
+    size_t cells(size_t i) const { return cell_index_[i + 1] - cell_index_[i]; }
 
-  template <typename> static constexpr std::false_type check(...);
+    // Cell `column` of row i (empty if the row has fewer cells)
+    Cell cell(size_t i, size_t column) const {
+      Cell result;
+      if (column >= cells(i))
+        return result;
+      const size_t index = cell_index_[i] + column;
+      result.buffer_ = buffer_;
+      result.start_ = cell_starts_[index];
+      result.end_ = cell_ends_[index];
+      result.escaped_ = cell_escaped_[index] != 0;
+      return result;
+    }
 
-  typedef decltype(check<C>(0)) type;
+    // Raw arrays: row offsets, the first cell of each row (size() + 1
+    // entries), and the (untrimmed) cell spans in the buffer
+    const char *data() const { return buffer_; }
+    const std::vector<size_t> &row_starts() const { return row_starts_; }
+    const std::vector<size_t> &row_ends() const { return row_ends_; }
+    const std::vector<size_t> &cell_index() const { return cell_index_; }
+    const std::vector<size_t> &cell_starts() const { return cell_starts_; }
+    const std::vector<size_t> &cell_ends() const { return cell_ends_; }
+  };
 
-public:
-  static constexpr bool value = type::value;
-};
+  // Range over the rows in blocks of up to `rows` rows, see batches()
+  class BatchRange {
+    const Reader *reader_;
+    size_t rows_;
 
-template <class delimiter = delimiter<','>, typename Stream = std::ofstream> class Writer {
-  Stream &stream_; // output stream for the writer
-public:
-  Writer(Stream &stream) : stream_(stream) {}
+  public:
+    class iterator {
+      RowIterator row_;
+      RowIterator end_;
+      size_t rows_;
+      RowBatch batch_; // reused for every block
+      size_t start_{0}; // offset of the first row of the block
+
+      void fill_() {
+        start_ = row_.start_;
+        batch_.clear_();
+        for (; batch_.size() < rows_ && row_ != end_; ++row_)
+          batch_.push_(*row_);
+      }
 
-  ~Writer() {
-    if constexpr (has_close<Stream, void()>::value) {
-      // has `close`
-      stream_.close();
-    }
-  }
+    public:
+      iterator(const Reader *reader, RowIterator row, size_t rows)
+          : row_(row), end_(reader->end()), rows_(rows) {
+        batch_.reader_ = reader;
+        batch_.buffer_ = reader->buffer_;
+        fill_();
+      }
 
-  template <typename Container> void write_row(Container &&row) {
-    const auto &strings = std::forward<Container>(row);
-    const auto delimiter_string = std::string(1, delimiter::value);
-    std::copy(strings.begin(), strings.end() - 1,
-              std::ostream_iterator<std::string>(stream_, delimiter_string.c_str()));
-    stream_ << strings.back() << "\n";
-  }
+      iterator &operator++() {
+        fill_();
+        return *this;
+      }
 
-  template <typename Container> void write_rows(Container &&rows) {
-    const auto &container_of_rows = std::forward<Container>(rows);
-    for (const auto &row : container_of_rows) {
-      write_row(row);
-    }
+      const RowBatch &operator*() const { return batch_; }
+
+      // iterators compare equal at the same block, or once the rows are
+      // exhausted
+      bool operator!=(const iterator &rhs) const {
+        const bool exhausted = batch_.size() == 0;
+        return exhausted != (rhs.batch_.size() == 0) || (!exhausted && start_ != rhs.start_);
+      }
+    };
+
+    BatchRange(const Reader *reader, size_t rows) : reader_(reader), rows_(rows) {}
+    iterator begin() const { return iterator(reader_, reader_->begin(), rows_); }
+    iterator end() const { return iterator(reader_, reader_->end(), rows_); }
+  };
+
+  // Iterate over the rows in batches of up to `rows` rows, e.g.,
+  // for (const auto &batch : csv.batches(1024)) { ... batch.cell(i, 2) ... }
+  // The batch is reused, it is valid until the iterator is incremented
+  BatchRange batches(size_t rows = 1024) const {
+    return BatchRange(this, std::max<size_t>(rows, 1));
   }
-};
 
-} // namespace csv2
+  // Iterates over the rows whose cell in a column matches a value, see filter()
+  class FilterRange {
+    const Reader *reader_;
+    size_t column_;
+    match kind_;
+    std::string value_;
+
+  public:
+    class iterator {
+      const FilterRange *range_;
+      size_t start_;
+      size_t end_;
+
+      // Moves to the first matching row at or after the row starting at `from`
+      void advance_(size_t from) {
+        const Reader &reader = *range_->reader_;
+        const std::string &value = range_->value_;
+        const char *buffer = reader.buffer_;
+        const size_t size = reader.buffer_size_;
+        while (from < size) {
+          // candidate: the first row (after `from`) that contains the value
+          const char *found = detail::find(buffer + from, buffer + size, value.data(), value.size());
+          if (not found)
+            break;
+          size_t start = found - buffer;
+          if (quoted_newlines::value) {
+            // rows can span lines, walk forward to the row containing the value
+            for (size_t end; (end = row_end_(buffer, size, reader.newline_, from)) < start;)
+              from = end + 1;
+            start = from;
+          } else {
+            while (start > from && buffer[start - 1] != reader.newline_)
+              --start;
+          }
+          const size_t end = row_end_(buffer, size, reader.newline_, start);
+          if (matches_(start, end)) {
+            start_ = start;
+            end_ = end;
+            return;
+          }
+          from = end + 1;
+        }
+        start_ = end_ = size + 1;
+      }
+
+      // Tokenizes the row [start, end) and compares the cell in the column
+      bool matches_(size_t start, size_t end) const {
+        const Reader &reader = *range_->reader_;
+        const char *first = reader.buffer_ + start, *last = reader.buffer_ + end;
+        if (comment_line_(first, last) or (ignore_empty_lines::value and reader.blank_line_(first, last)))
+          return false;
+        const Row row = reader.row_(start, end);
+        const Cell cell = row.get(range_->column_);
+        if (row.length() == 0 or cell.buffer_ == nullptr)
+          return false;
+
+        const auto span = reader.unquoted_(cell);
+        const char *text = cell.buffer_ + span.first;
+        const size_t length = span.second - span.first;
+        const std::string &value = range_->value_;
+        switch (range_->kind_) {
+        case match::equals:
+          return length == value.size() and memcmp(text, value.data(), length) == 0;
+        case match::prefix:
+          return length >= value.size() and memcmp(text, value.data(), value.size()) == 0;
+        default:
+          return detail::find(text, text + length, value.data(), value.size()) != nullptr;
+        }
+      }
+
+    public:
+      iterator(const FilterRange *range, size_t start) : range_(range), start_(start), end_(start) {
+        if (start_ <= range_->reader_->buffer_size_)
+          advance_(start_);
+      }
+
+      iterator &operator++() {
+        advance_(end_ + 1);
+        return *this;
+      }
+
+      Row operator*() const { return range_->reader_->row_(start_, end_); }
+
+      bool operator!=(const iterator &rhs) { return start_ != rhs.start_; }
+    };
+
+    FilterRange(const Reader *reader, size_t column, match kind, std::string value)
+        : reader_(reader), column_(column), kind_(kind), value_(std::move(value)) {}
+    iterator begin() const {
+      return iterator(this, reader_->buffer_ ? reader_->begin().start_ : 0);
+    }
+    iterator end() const { return iterator(this, reader_->buffer_size_ + 1); }
+  };
+
+  // Iterate over the rows whose cell in `column` equals, starts with or
+  // contains `value` (after trimming and removing enclosing quotes), e.g.,
+  // for (auto row : csv.filter(2, csv2::match::equals, "NYSE")) { ... }
+  // Candidate rows are located with a substring search over the buffer and
+  // only those rows are tokenized
+  FilterRange filter(size_t column, match kind, std::string value) const {
+    return FilterRange(this, column, kind, std::move(value));
+  }
+
+private:
+  template <class R> friend std::vector<size_t> split_points(const R &reader, size_t count);
+  template <class R>
+  friend std::vector<typename R::Row> sample(const R &reader, size_t count, uint64_t seed);
+
+  constexpr static size_t last_column_() { return 0; }
+
+  template <class... Tail> constexpr static size_t last_column_(size_t head, Tail... tail) {
+    return head > last_column_(tail...) ? head : last_column_(tail...);
+  }
+
+  std::vector<Cell> header_cells_;   // cells of the header row (cache)
+  std::vector<size_t> column_slots_; // open-addressing table of column index + 1
+
+  // Hashes a column name with FNV-1a
+  static size_t hash_name_(const char *name, size_t length) {
+    size_t result = static_cast<size_t>(14695981039346656037ULL);
+    for (size_t i = 0; i < length; ++i) {
+      result ^= static_cast<unsigned char>(name[i]);
+      result *= static_cast<size_t>(1099511628211ULL);
+    }
+    return result;
+  }
+
+  // Trimmed cell contents without enclosing quotes, in cell.buffer_
+  static std::pair<size_t, size_t> unquoted_(const Cell &cell) {
+    auto span = trim_policy::trim(cell.buffer_, cell.start_, cell.end_);
+    if (span.second - span.first >= 2 && cell.buffer_[span.first] == quote_character::value &&
+        cell.buffer_[span.second - 1] == quote_character::value) {
+      span.first += 1;
+      span.second -= 1;
+    }
+    return span;
+  }
+
+  // Detects the line ending: "\r\n" if the first '\n' follows a '\r', and
+  // a lone '\r' only if the buffer has no '\n' at all, so that a stray '\r'
+  // inside a line does not change how the file is split
+  void detect_line_ending_() {
+    const char *lf = static_cast<const char *>(memchr(buffer_, '\n', buffer_size_));
+    newline_ = !lf && memchr(buffer_, '\r', buffer_size_) ? '\r' : '\n';
+    crlf_ = lf && lf > buffer_ && lf[-1] == '\r';
+  }
+
+  // Detects the line ending, tokenizes the header once and builds
+  // the column name lookup table
+  void index_() {
+    header_start_ = 0;
+    header_end_ = buffer_size_;
+    rows_start_ = buffer_size_ + 1;
+    first_row_ = first_row_is_header::value ? rows_start_ : header_start_;
+    header_buffer_ = buffer_;
+    truncated_ = 0;
+    newline_ = '\n';
+    crlf_ = false;
+    header_cells_.clear();
+    column_slots_.clear();
+#if __CSV2_HAS_MMAN_H__
+    header_mmap_.unmap();
+#endif
+    if (buffer_size_ == 0)
+      return;
+
+    detect_line_ending_();
+
+    // skip the leading lines, comments and (optionally) empty lines,
+    // the header is the next line
+    for (size_t line = 0; line < skip_rows::value && header_start_ < buffer_size_; ++line) {
+      const char *ptr = static_cast<const char *>(
+          memchr(&buffer_[header_start_], newline_, buffer_size_ - header_start_));
+      header_start_ = ptr ? (ptr - buffer_) + 1 : buffer_size_;
+    }
+    header_start_ = std::min(skip_lines_(buffer_, buffer_size_, newline_, header_start_),
+                             buffer_size_);
+
+    header_end_ = row_end_(buffer_, buffer_size_, newline_, header_start_);
+    if (header_end_ < buffer_size_)
+      rows_start_ = header_end_ + 1;
+    first_row_ = first_row_is_header::value ? rows_start_ : header_start_;
+    if (crlf_ && header_end_ > header_start_ && buffer_[header_end_ - 1] == '\r')
+      header_end_ -= 1;
+
+    Row header;
+    header.reader_ = this;
+    header.buffer_ = buffer_;
+    header.start_ = header_start_;
+    header.end_ = header_end_;
+    for (const auto cell : header)
+      header_cells_.push_back(cell);
+
+    size_t capacity = 4;
+    while (capacity < header_cells_.size() * 2)
+      capacity *= 2;
+    column_slots_.assign(capacity, 0);
+    for (size_t i = 0; i < header_cells_.size(); ++i) {
+      const auto span = unquoted_(header_cells_[i]);
+      size_t slot = hash_name_(buffer_ + span.first, span.second - span.first) & (capacity - 1);
+      while (column_slots_[slot] != 0)
+        slot = (slot + 1) & (capacity - 1);
+      column_slots_[slot] = i + 1;
+    }
+  }
+
+  // Can `c` be part of a blank line (other than its terminator)?
+  static bool blank_character_(char c, char newline) {
+    return c == ' ' || c == '\t' || (c == '\r' && newline != '\r');
+  }
+
+  // Does the line [first, last) start with the comment character?
+  static bool comment_line_(const char *first, const char *last) {
+    return comment_character::value != '\0' && first != last &&
+           *first == comment_character::value;
+  }
+
+  // Is the line [first, last), without its terminator, empty or whitespace?
+  bool blank_line_(const char *first, const char *last) const {
+    while (first != last && blank_character_(*first, newline_))
+      ++first;
+    return first == last;
+  }
+
+#if __CSV2_HAS_MMAN_H__
+  // Maps a growing prefix of the file, advised as sequential, until it holds
+  // the first limit_ rows, then truncates the buffer after them
+  template <typename StringType> bool mmap_head_(StringType &&filename) {
+    const size_t file_size = file_size_(filename);
+    if (file_size == 0)
+      return false;
+
+    for (size_t length = size_t(64) << 10;; length *= 2) {
+      length = std::min(length, file_size);
+      std::error_code error;
+      mmap_.map(filename, 0, length, error);
+      if (error)
+        return false;
+#if defined(POSIX_MADV_SEQUENTIAL)
+      posix_madvise(const_cast<char *>(mmap_.data()), mmap_.mapped_length(),
+                    POSIX_MADV_SEQUENTIAL);
+#endif
+      buffer_ = mmap_.data();
+      buffer_size_ = mmap_.mapped_length();
+      index_();
+      if (truncate_() || length == file_size)
+        return true;
+    }
+  }
+
+  // Size of the file at `path`, 0 if it cannot be opened
+  template <typename StringType> static size_t file_size_(StringType &&path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    const std::streamoff size = file ? static_cast<std::streamoff>(file.tellg()) : 0;
+    return size > 0 ? static_cast<size_t>(size) : 0;
+  }
+
+  // Offset after the last line terminator (outside quotes) in the buffer,
+  // i.e., where follow() picks up; the start of the rows if there is none.
+  // After limit(n), that is the terminator of the n-th row, cut by truncate_
+  size_t complete_end_() const {
+    if (truncated_)
+      return truncated_;
+    const size_t first = std::min(begin().start_, buffer_size_);
+    bool odd = false; // odd number of quote characters after `position`?
+    for (size_t position = buffer_size_;;) {
+      const char *found = detail::find_last(buffer_ + first, buffer_ + position, newline_);
+      if (not found)
+        return first;
+      const size_t next = found - buffer_ + 1;
+      if (quoted_newlines::value)
+        odd = odd != odd_quotes_(buffer_ + next, buffer_ + position);
+      if (not odd)
+        return next;
+      position = next - 1;
+    }
+  }
+#endif
+
+  // Truncates the buffer after the limit_-th row; false if the buffer ends
+  // before that row is complete
+  bool truncate_() {
+    if (limit_ == 0 || !buffer_)
+      return false;
+    size_t count{0};
+    for (auto it = begin(), last = end(); it != last; ++it) {
+      *it;
+      if (++count == limit_) {
+        if (it.end_ >= buffer_size_)
+          return false;
+        buffer_size_ = it.end_;
+        truncated_ = it.end_ + 1;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // The first row boundary at or after `offset` (0 < offset <= size), with
+  // rows that span lines; buffer_size_ + 1 if there is none
+  size_t resync_(size_t offset) const {
+    const size_t quotes =
+        detail::count(buffer_ + offset, buffer_size_ - offset, quote_character::value);
+    return resync_(offset, quotes % 2 != 0);
+  }
+
+  // Same, given whether `offset` lies inside a quoted section
+  size_t resync_(size_t offset, bool inside) const {
+    if (not inside and buffer_[offset - 1] == newline_)
+      return offset;
+    for (size_t i = offset; i < buffer_size_; ++i) {
+      if (buffer_[i] == quote_character::value)
+        inside = not inside;
+      else if (buffer_[i] == newline_ and not inside)
+        return i + 1;
+    }
+    return buffer_size_ + 1;
+  }
+
+  // See csv2::split_points
+  std::vector<size_t> split_points_(size_t count) const {
+    count = std::max<size_t>(count, 1);
+    const size_t first = std::min(first_row_, buffer_size_), length = buffer_size_ - first;
+    std::vector<size_t> targets(count + 1), result(count + 1, buffer_size_);
+    for (size_t i = 0; i < count; ++i)
+      targets[i] = first + length / count * i + std::min(i, length % count);
+    targets[count] = buffer_size_;
+    result[0] = first;
+
+    // with quoted newlines, whether each target lies inside quotes follows
+    // from the parity of the quotes after it: one count per chunk
+    std::vector<char> inside(count + 1, 0);
+    if (quoted_newlines::value) {
+      std::vector<size_t> quotes(count);
+      const size_t threads = length < (size_t(64) << 20) ? 1 : detail::thread_count(0);
+      detail::parallel_for(count, threads, [&](size_t i) {
+        quotes[i] = detail::count(buffer_ + targets[i], targets[i + 1] - targets[i],
+                                  quote_character::value);
+      });
+      for (size_t i = count; i-- > 0;)
+        inside[i] = inside[i + 1] != (quotes[i] % 2 != 0);
+    }
+
+    for (size_t i = 1; i < count; ++i) {
+      size_t offset = first;
+      if (targets[i] > first)
+        offset = quoted_newlines::value ? resync_(targets[i], inside[i] != 0)
+                                        : begin(targets[i]).start_;
+      result[i] = std::max(result[i - 1], std::min(offset, buffer_size_));
+    }
+    return result;
+  }
+
+  // See csv2::sample
+  std::vector<Row> sample_(size_t count, uint64_t seed) const {
+    std::vector<Row> result;
+    if (!buffer_ || count == 0 || first_row_ >= buffer_size_)
+      return result;
+    std::mt19937_64 random(seed);
+
+    // probing pays off if the sample is a small part of the rows
+    if (not quoted_newlines::value && count * 8 < estimate_rows(8).rows) {
+      std::uniform_int_distribution<size_t> offsets(first_row_, buffer_size_ - 1);
+      std::uniform_real_distribution<double> uniform(0.0, 1.0);
+      std::unordered_set<size_t> starts;
+      size_t shortest = buffer_size_ + 1; // shortest row probed so far
+      for (size_t probe = 0; probe < 256 * count + 1024 && result.size() < count; ++probe) {
+        // the row holding a random byte, picked with a probability
+        // proportional to its length
+        const size_t offset = offsets(random);
+        const char *found = detail::find_last(buffer_ + first_row_, buffer_ + offset, newline_);
+        const size_t start = found ? found - buffer_ + 1 : first_row_;
+        const size_t end = row_end_(buffer_, buffer_size_, newline_, start);
+        if (comment_line_(buffer_ + start, buffer_ + end) or
+            (ignore_empty_lines::value and blank_line_(buffer_ + start, buffer_ + end)))
+          continue;
+
+        // rows are accepted with probability shortest / length, which undoes
+        // the length bias; when a shorter row turns up, the rows accepted so
+        // far are thinned out to match the new ratio
+        const size_t length = std::min(end + 1, buffer_size_) - start;
+        if (length < shortest) {
+          size_t kept{0};
+          for (size_t i = 0; i < result.size(); ++i) {
+            if (uniform(random) * shortest < length)
+              result[kept++] = result[i];
+            else
+              starts.erase(result[i].start_);
+          }
+          result.resize(kept);
+          shortest = length;
+        }
+        if (uniform(random) * length < shortest && starts.insert(start).second)
+          result.push_back(row_(start, end));
+      }
+      if (result.size() == count) {
+        std::sort(result.begin(), result.end(),
+                  [](const Row &a, const Row &b) { return a.start_ < b.start_; });
+        return result;
+      }
+      result.clear();
+    }
+
+    // exact reservoir sampling over all rows
+    size_t seen{0};
+    for (auto it = begin(), last = end(); it != last; ++it) {
+      const Row row = *it;
+      if (row.start_ >= buffer_size_)
+        break; // the empty row after a trailing line terminator
+      if (seen < count) {
+        result.push_back(row);
+      } else {
+        const size_t slot = std::uniform_int_distribution<size_t>(0, seen)(random);
+        if (slot < count)
+          result[slot] = row;
+      }
+      ++seen;
+    }
+    std::sort(result.begin(), result.end(),
+              [](const Row &a, const Row &b) { return a.start_ < b.start_; });
+    return result;
+  }
+
+  // Is the number of quote characters in [first, last) odd?
+  static bool odd_quotes_(const char *first, const char *last) {
+    const char quote = quote_character::value;
+    return std::count(first, last, quote) % 2 != 0;
+  }
+
+  // The row [start, end), without a trailing '\r' of a "\r\n" ending
+  Row row_(size_t start, size_t end) const { return row_(buffer_, start, end); }
+  Row row_(const char *buffer, size_t start, size_t end) const {
+    Row result;
+    result.reader_ = this;
+    result.buffer_ = buffer;
+    result.start_ = start;
+    result.end_ = end;
+    if (crlf_ && end > start && buffer[end - 1] == '\r')
+      result.end_ = end - 1;
+    return result;
+  }
+
+  // Number of rows ended by a line terminator in [first, last), where
+  // `first` is the start of a line
+  size_t window_rows_(const char *first, const char *last) const {
+    if (comment_character::value == '\0' && not ignore_empty_lines::value)
+      return detail::count_lines(first, last - first, newline_, quote_character::value,
+                                 quoted_newlines::value)
+          .outside;
+    size_t result{0};
+    for (const char *p = first; (p = static_cast<const char *>(memchr(p, newline_, last - p)));
+         first = ++p) {
+      if (not comment_line_(first, p) and
+          (not ignore_empty_lines::value or not blank_line_(first, p)))
+        ++result;
+    }
+    return result;
+  }
+
+  // Returns the index of the line terminator that ends the row starting at
+  // `start`, or buffer_size for the last row; with quoted_newlines, line
+  // terminators inside quoted sections do not end the row
+  static size_t row_end_(const char *buffer, size_t buffer_size, char newline, size_t start) {
+    bool inside = false;
+    for (size_t search = start; search < buffer_size;) {
+      const char *ptr =
+          static_cast<const char *>(memchr(&buffer[search], newline, buffer_size - search));
+      if (not ptr)
+        break;
+      const size_t end = ptr - buffer;
+      if (!quoted_newlines::value)
+        return end;
+      for (size_t i = search; i < end; ++i)
+        inside = inside != (buffer[i] == quote_character::value);
+      if (!inside)
+        return end;
+      search = end + 1;
+    }
+    return buffer_size;
+  }
+
+  // Returns the start of the first line at or after the line starting at
+  // `start` that is neither a comment nor, if ignore_empty_lines, blank;
+  // buffer_size + 1 if there is none
+  static size_t skip_lines_(const char *buffer, size_t buffer_size, char newline, size_t start) {
+    if (comment_character::value == '\0' && !ignore_empty_lines::value)
+      return start;
+    while (start <= buffer_size) {
+      size_t i = start;
+      if (ignore_empty_lines::value) {
+        while (i < buffer_size && blank_character_(buffer[i], newline))
+          ++i;
+        if (i == buffer_size) {
+          start = buffer_size + 1;
+          break;
+        }
+        if (buffer[i] == newline) {
+          start = i + 1;
+          continue;
+        }
+      }
+      if (comment_character::value == '\0' || start == buffer_size ||
+          buffer[start] != comment_character::value)
+        break;
+      const char *ptr = static_cast<const char *>(memchr(&buffer[i], newline, buffer_size - i));
+      start = ptr ? (ptr - buffer) + 1 : buffer_size + 1;
+    }
+    return start;
+  }
+
+public:
+
+  Row header() const {
+    Row result;
+    result.reader_ = this;
+    result.buffer_ = header_buffer_;
+    result.start_ = header_start_;
+    result.end_ = header_end_;
+    return result;
+  }
+
+  /**
+   * @returns The index of the header column called `name` (trimmed,
+   * with enclosing quotes removed), or std::string::npos if there is none.
+   * Duplicate names resolve to the leftmost column.
+  */
+  size_t column_index(const char *name, size_t length) const {
+    if (column_slots_.empty())
+      return std::string::npos;
+    const size_t mask = column_slots_.size() - 1;
+    size_t result = std::string::npos;
+    for (size_t slot = hash_name_(name, length) & mask; column_slots_[slot] != 0;
+         slot = (slot + 1) & mask) {
+      const size_t index = column_slots_[slot] - 1;
+      const auto span = unquoted_(header_cells_[index]);
+      if (span.second - span.first == length &&
+          memcmp(header_buffer_ + span.first, name, length) == 0 && index < result)
+        result = index;
+    }
+    return result;
+  }
+
+  // Name of header column `index` as used by column_index, or "" if out of range
+  std::string column_name(size_t index) const {
+    if (index >= header_cells_.size())
+      return std::string();
+    const auto span = unquoted_(header_cells_[index]);
+    return std::string(header_buffer_ + span.first, header_buffer_ + span.second);
+  }
+
+  size_t column_index(const char *name) const { return column_index(name, strlen(name)); }
+  size_t column_index(const std::string &name) const {
+    return column_index(name.data(), name.size());
+  }
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+  size_t column_index(std::string_view name) const {
+    return column_index(name.data(), name.size());
+  }
+#endif
+
+  /**
+   * @returns The number of rows (excluding the header), i.e., the number of
+   * rows visited by begin()..end(). Empty and whitespace-only lines are not
+   * counted if skip_empty_lines or the ignore_empty_lines policy is set.
+   * Without comments or empty-line skipping, line terminators are counted
+   * 64 bytes at a time (vector compare + popcount), on all hardware threads
+   * for buffers of 64 MB and more
+  */
+  size_t rows(bool skip_empty_lines = false) const {
+    size_t result{0};
+    if (!buffer_ || buffer_size_ == 0)
+      return result;
+
+    const bool skip_empty = skip_empty_lines || ignore_empty_lines::value;
+    const char *last = buffer_ + buffer_size_;
+    const char *row = buffer_ + first_row_;
+    if (row > last)
+      return result;
+
+    // every line terminator (outside quotes) ends a row, plus the last row
+    if (comment_character::value == '\0' && not skip_empty)
+      return detail::count_lines_parallel(row, last - row, newline_, quote_character::value,
+                                          quoted_newlines::value) +
+             1;
+
+    if (quoted_newlines::value) {
+      for (auto it = begin(), end_it = end(); it != end_it; ++it) {
+        const Row current = *it;
+        if (not skip_empty or not blank_line_(buffer_ + current.start_, buffer_ + current.end_))
+          ++result;
+      }
+      return result;
+    }
+    for (const char *p = row; (p = static_cast<const char *>(memchr(p, newline_, last - p)));
+         row = ++p) {
+      if (not comment_line_(row, p) and (not skip_empty or not blank_line_(row, p)))
+        ++result;
+    }
+    // the last row (after the last line terminator)
+    if (not comment_line_(row, last) and (not skip_empty or not blank_line_(row, last)))
+      ++result;
+    return result;
+  }
+
+  /**
+   * Estimates rows() from `samples` evenly spaced 64 KB windows of the buffer,
+   * extrapolating the rows per byte seen in the windows (ratio estimator) to
+   * the whole buffer. Only the windows are read; buffers too small to sample
+   * are counted exactly
+  */
+  RowEstimate estimate_rows(size_t samples = 32) const {
+    const size_t window = size_t(64) << 10;
+    samples = std::max<size_t>(samples, 2);
+    const size_t first = first_row_;
+    if (!buffer_ || first > buffer_size_ || buffer_size_ - first <= 2 * samples * window) {
+      const size_t count = rows();
+      return RowEstimate{count, count, count, true};
+    }
+
+    const char *last = buffer_ + buffer_size_;
+    const size_t length = buffer_size_ - first;
+    std::vector<double> counts(samples), sizes(samples);
+    double total_count = 0, total_size = 0;
+    for (size_t i = 0; i < samples; ++i) {
+      // each window starts at the beginning of a line
+      const char *start = buffer_ + first + i * ((length - window) / (samples - 1));
+      if (i > 0) {
+        const char *ptr = static_cast<const char *>(memchr(start - 1, newline_, last - start + 1));
+        start = ptr ? ptr + 1 : last;
+      }
+      const size_t size = std::min<size_t>(window, last - start);
+      counts[i] = static_cast<double>(window_rows_(start, start + size));
+      sizes[i] = static_cast<double>(size);
+      total_count += counts[i];
+      total_size += sizes[i];
+    }
+    if (total_size == 0) {
+      const size_t count = rows();
+      return RowEstimate{count, count, count, true};
+    }
+
+    const double ratio = total_count / total_size, mean_size = total_size / samples;
+    double variance = 0;
+    for (size_t i = 0; i < samples; ++i)
+      variance += (counts[i] - ratio * sizes[i]) * (counts[i] - ratio * sizes[i]);
+    variance /= samples * (samples - 1) * mean_size * mean_size;
+
+    // +1 for the last row, which has no line terminator
+    const double estimate = ratio * length + 1, margin = 1.96 * std::sqrt(variance) * length;
+    const double lower = std::max(1.0, estimate - margin),
+                 upper = std::min(static_cast<double>(length + 1), estimate + margin);
+    return RowEstimate{static_cast<size_t>(estimate + 0.5), static_cast<size_t>(lower),
+                       static_cast<size_t>(std::ceil(upper)), false};
+  }
+
+  size_t cols() const { return header_cells_.size(); }
+};
+
+// Splits the rows of `reader` into `count` chunks of roughly equal size at
+// row boundaries, e.g., for separate worker processes that each map their
+// chunk with Reader::mmap(path, offset, length). Returns count + 1 offsets;
+// chunk i holds the rows starting in [offsets[i], offsets[i + 1]). Rows that
+// span lines (quoted_newlines) are never split
+template <class Reader> std::vector<size_t> split_points(const Reader &reader, size_t count) {
+  return reader.split_points_(count);
+}
+
+namespace detail {
+
+// Iterator at an offset from split_points. Offsets inside the buffer are
+// row starts; reader.size() is clamped "no more rows", which begin(offset)
+// maps to end(), or to the empty row after a trailing line terminator
+template <class Reader>
+typename Reader::RowIterator split_iterator(const Reader &reader, size_t offset) {
+  typedef typename Reader::RowIterator RowIterator;
+  return offset < reader.size() ? RowIterator(reader.data(), reader.size(), offset, &reader)
+                                : reader.begin(offset);
+}
+
+// The rows of chunk `i` of split_points `offsets`, as [first, second); the
+// last chunk runs up to reader.end() like iteration
+template <class Reader>
+std::pair<typename Reader::RowIterator, typename Reader::RowIterator>
+chunk_bounds(const Reader &reader, const std::vector<size_t> &offsets, size_t i) {
+  return std::make_pair(i == 0 ? reader.begin() : split_iterator(reader, offsets[i]),
+                        i + 2 == offsets.size() ? reader.end()
+                                                : split_iterator(reader, offsets[i + 1]));
+}
+
+} // namespace detail
+
+// Picks `count` rows of `reader` (all rows if there are fewer) at random,
+// returned in buffer order. For samples that are a small part of a large
+// buffer, random byte offsets are probed: the row holding the byte is
+// accepted with a probability inversely proportional to its length, which
+// undoes the bias towards long rows, so only O(count) pages are touched.
+// Otherwise, and with quoted_newlines, all rows are reservoir-sampled
+template <class Reader>
+std::vector<typename Reader::Row> sample(const Reader &reader, size_t count, uint64_t seed) {
+  return reader.sample_(count, seed);
+}
+
+} // namespace csv2
+#pragma once
+// #include <csv2/parallel.hpp>
+// #include <csv2/reader.hpp>
+#include <vector>
+
+namespace csv2 {
+
+enum class layout { row_major, column_major };
+
+template <typename T> class Matrix;
+
+template <typename T, class Reader>
+Matrix<T> load_matrix(const Reader &reader, layout order = layout::row_major,
+                      size_t threads = 0, const NullValues &nulls = NullValues());
+
+template <typename T> class Matrix {
+public:
+  // Cell that could not be converted (left as T{} in the matrix)
+  struct Failure {
+    size_t row;
+    size_t col;
+  };
+
+  Matrix(size_t rows, size_t cols, layout order)
+      : rows_(rows), cols_(cols), order_(order), data_(rows * cols),
+        validity_((rows * cols + 63) / 64, ~uint64_t(0)), null_count_(0) {}
+
+  size_t rows() const { return rows_; }
+  size_t cols() const { return cols_; }
+  layout order() const { return order_; }
+
+  T &operator()(size_t row, size_t col) { return data_[index(row, col)]; }
+  const T &operator()(size_t row, size_t col) const { return data_[index(row, col)]; }
+
+  // Contiguous storage, in row-major or column-major order
+  T *data() { return data_.data(); }
+  const T *data() const { return data_.data(); }
+
+  // Failed cells, in file order
+  const std::vector<Failure> &failures() const { return failures_; }
+
+  // Validity bitmap: bit (i % 64) of word i / 64 is cleared if the cell
+  // stored at data()[i] is null or failed to convert
+  const std::vector<uint64_t> &validity() const { return validity_; }
+  bool is_valid(size_t row, size_t col) const {
+    const size_t i = index(row, col);
+    return (validity_[i / 64] >> (i % 64)) & 1;
+  }
+
+  // Number of cells that matched a null token
+  size_t null_count() const { return null_count_; }
+
+private:
+  template <typename U, class Reader>
+  friend Matrix<U> load_matrix(const Reader &, layout, size_t, const NullValues &);
+
+  void invalidate_(size_t i) { validity_[i / 64] &= ~(uint64_t(1) << (i % 64)); }
+
+  size_t index(size_t row, size_t col) const {
+    return order_ == layout::row_major ? row * cols_ + col : col * rows_ + row;
+  }
+
+  size_t rows_;
+  size_t cols_;
+  layout order_;
+  std::vector<T> data_;
+  std::vector<Failure> failures_;
+  std::vector<uint64_t> validity_;
+  size_t null_count_;
+};
+
+// Loads every (non-empty) data row of `reader` into a dense matrix with
+// reader.cols() columns. The buffer is split into record-aligned chunks
+// that are parsed in parallel: a first pass counts the rows of every chunk
+// so that the second pass can convert cells straight into their final
+// location. Cells matching one of the `nulls` tokens are left as T{} and
+// cleared in the validity bitmap. Cells that are missing or fail to convert
+// are cleared too and reported in Matrix::failures(); extra cells are ignored
+template <typename T, class Reader>
+Matrix<T> load_matrix(const Reader &reader, layout order, size_t threads,
+                      const NullValues &nulls) {
+  threads = detail::thread_count(threads);
+  const size_t chunks = reader.size() < (1 << 20) ? 1 : threads * 8;
+  const auto offsets = split_points(reader, chunks);
+
+  std::vector<size_t> chunk_rows(chunks + 1, 0);
+  detail::parallel_for(chunks, threads, [&](size_t chunk) {
+    size_t rows = 0;
+    for (auto it = detail::chunk_bounds(reader, offsets, chunk); it.first != it.second; ++it.first)
+      rows += size_t((*it.first).length() > 0);
+    chunk_rows[chunk + 1] = rows;
+  });
+  for (size_t chunk = 0; chunk < chunks; ++chunk)
+    chunk_rows[chunk + 1] += chunk_rows[chunk];
+
+  Matrix<T> result(chunk_rows[chunks], reader.cols(), order);
+  std::vector<std::vector<typename Matrix<T>::Failure>> failures(chunks);
+  std::vector<std::vector<size_t>> null_cells(chunks);
+  detail::parallel_for(chunks, threads, [&](size_t chunk) {
+    size_t row = chunk_rows[chunk];
+    for (auto it = detail::chunk_bounds(reader, offsets, chunk); it.first != it.second;
+         ++it.first) {
+      const auto cells = *it.first;
+      if (cells.length() == 0)
+        continue;
+      size_t col = 0;
+      for (auto cell = cells.begin(), cells_end = cells.end();
+           col < result.cols_ && cell != cells_end; ++cell, ++col) {
+        const auto value = *cell;
+        if (value.is_null(nulls)) {
+          null_cells[chunk].push_back(result.index(row, col));
+        } else if (!value.get(result(row, col))) {
+          result(row, col) = T();
+          failures[chunk].push_back({row, col});
+        }
+      }
+      for (; col < result.cols_; ++col)
+        failures[chunk].push_back({row, col});
+      row += 1;
+    }
+  });
+
+  // Bitmap words are shared between chunks, so clear bits after the join
+  for (const auto &chunk_failures : failures) {
+    result.failures_.insert(result.failures_.end(), chunk_failures.begin(), chunk_failures.end());
+    for (const auto &failure : chunk_failures)
+      result.invalidate_(result.index(failure.row, failure.col));
+  }
+  for (const auto &chunk_nulls : null_cells) {
+    result.null_count_ += chunk_nulls.size();
+    for (const auto i : chunk_nulls)
+      result.invalidate_(i);
+  }
+  return result;
+}
+
+} // namespace csv2
+#pragma once
+// #include <csv2/parallel.hpp>
+// #include <csv2/reader.hpp>
+#include <string>
+#include <vector>
+
+namespace csv2 {
+
+enum class data_type { boolean, integer, floating, date, timestamp, string };
+
+struct Column {
+  std::string name;
+  data_type type;
+  bool nullable;
+};
+
+struct Schema {
+  std::vector<Column> columns;
+  size_t sampled_rows;
+};
+
+struct SchemaOptions {
+  size_t rows = 4096;  // number of rows to sample in total
+  size_t windows = 64; // evenly spaced windows the rows are taken from
+  size_t threads = 0;  // 0 = one per hardware thread
+  NullValues nulls;    // tokens that mark a missing value
+};
+
+namespace detail {
+
+// Set of data_types a cell (or a column) is compatible with
+struct type_set {
+  unsigned mask;
+
+  static constexpr unsigned bit(data_type type) { return 1u << static_cast<unsigned>(type); }
+  static constexpr unsigned all() { return (bit(data_type::string) << 1) - 1; }
+
+  // Most specific type in the set; string is always a member
+  data_type narrowest() const {
+    for (unsigned type = 0; type < static_cast<unsigned>(data_type::string); ++type)
+      if (mask & (1u << type))
+        return static_cast<data_type>(type);
+    return data_type::string;
+  }
+};
+
+enum char_class : unsigned char {
+  char_digit = 1,
+  char_sign = 2,   // + -
+  char_number = 4, // . e E
+  char_date = 8,   // : T Z and space
+  char_other = 16
+};
+
+// Classes of all 256 byte values, so that a cell can be classified with
+// one table lookup and OR per character before any parser runs
+inline const unsigned char *char_classes() {
+  static const struct table {
+    unsigned char classes[256];
+    table() {
+      for (unsigned c = 0; c < 256; ++c)
+        classes[c] = char_other;
+      for (unsigned c = '0'; c <= '9'; ++c)
+        classes[c] = char_digit;
+      classes[unsigned('+')] = classes[unsigned('-')] = char_sign;
+      classes[unsigned('.')] = classes[unsigned('e')] = classes[unsigned('E')] = char_number;
+      classes[unsigned(':')] = classes[unsigned('T')] = classes[unsigned('Z')] = char_date;
+      classes[unsigned(' ')] = char_date;
+    }
+  } instance;
+  return instance.classes;
+}
+
+} // namespace detail
+
+// Classifies a (non-null) cell into the set of types it is compatible with
+template <> struct convert<detail::type_set> {
+  static bool parse(const char *first, const char *last, detail::type_set &result) {
+    typedef detail::type_set types;
+    const size_t length = last - first;
+    result.mask = types::bit(data_type::string);
+    if (length == 0)
+      return true;
+
+    const unsigned char *classes = detail::char_classes();
+    unsigned seen = 0;
+    for (const char *c = first; c != last; ++c)
+      seen |= classes[static_cast<unsigned char>(*c)];
+
+    bool flag;
+    if (seen & detail::char_other) {
+      if (convert<bool>::parse(first, last, flag) && length > 1)
+        result.mask |= types::bit(data_type::boolean);
+      return true;
+    }
+
+    int64_t integer;
+    double floating;
+    timestamp time;
+    if (!(seen & (detail::char_number | detail::char_date)) &&
+        convert<int64_t>::parse(first, last, integer))
+      result.mask |= types::bit(data_type::integer) | types::bit(data_type::floating);
+    else if (!(seen & detail::char_date) && convert<double>::parse(first, last, floating))
+      result.mask |= types::bit(data_type::floating);
+    else if (convert<timestamp>::parse(first, last, time))
+      result.mask |= types::bit(data_type::timestamp) |
+                     (length == 10 ? types::bit(data_type::date) : 0u);
+    return true;
+  }
+};
+
+// Infers the type and nullability of every header column from rows sampled
+// at evenly spaced offsets across the buffer. The windows are classified in
+// parallel and their results merged; a column is nullable if a sampled cell
+// is missing or one of options.nulls, and a column without any non-null
+// sample is a string
+template <class Reader> Schema infer_schema(const Reader &reader, const SchemaOptions &options) {
+  struct state {
+    std::vector<unsigned> types; // compatible types per column
+    std::vector<bool> nullable;
+    std::vector<bool> seen;
+    size_t rows = 0;
+  };
+
+  const size_t cols = reader.cols();
+  const size_t windows = options.windows == 0 ? 1 : options.windows;
+  const size_t quota = (options.rows + windows - 1) / windows;
+  const auto offsets = split_points(reader, windows);
+
+  std::vector<state> states(windows);
+  detail::parallel_for(windows, options.threads, [&](size_t window) {
+    state &result = states[window];
+    result.types.assign(cols, detail::type_set::all());
+    result.nullable.assign(cols, false);
+    result.seen.assign(cols, false);
+    for (auto it = detail::chunk_bounds(reader, offsets, window);
+         result.rows < quota && it.first != it.second; ++it.first) {
+      const auto row = *it.first;
+      if (row.length() == 0)
+        continue;
+      size_t col = 0;
+      for (auto cell = row.begin(), cells_end = row.end(); col < cols && cell != cells_end;
+           ++cell, ++col) {
+        const auto value = *cell;
+        detail::type_set types;
+        if (value.is_null(options.nulls)) {
+          result.nullable[col] = true;
+        } else {
+          value.get(types);
+          result.types[col] &= types.mask;
+          result.seen[col] = true;
+        }
+      }
+      for (; col < cols; ++col)
+        result.nullable[col] = true;
+      result.rows += 1;
+    }
+  });
+
+  Schema result;
+  result.sampled_rows = 0;
+  for (size_t col = 0; col < cols; ++col) {
+    detail::type_set types{detail::type_set::all()};
+    bool nullable = false, seen = false;
+    for (const auto &window : states) {
+      types.mask &= window.types[col];
+      nullable = nullable || window.nullable[col];
+      seen = seen || window.seen[col];
+    }
+    result.columns.push_back(
+        Column{reader.column_name(col), seen ? types.narrowest() : data_type::string, nullable});
+  }
+  for (const auto &window : states)
+    result.sampled_rows += window.rows;
+  return result;
+}
+
+template <class Reader> Schema infer_schema(const Reader &reader) {
+  return infer_schema(reader, SchemaOptions());
+}
+
+} // namespace csv2
+#pragma once
+#include <atomic>
+#include <cstdint>
+// #include <csv2/parallel.hpp>
+// #include <csv2/reader.hpp>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace csv2 {
+
+namespace detail {
+
+// Number of record-aligned morsels for the parallel row algorithms: about
+// 256 KB each, and enough for every thread to have a few to give away
+inline size_t morsel_count(size_t size, size_t threads) {
+  return std::max<size_t>(1, std::min(size >> 12, std::max(threads * 8, size >> 18)));
+}
+
+// Calls function(row) for the rows of morsel `i` of `offsets` (from
+// split_points); the last morsel runs up to reader.end() like iteration
+template <class Reader, class Function>
+void for_each_in_morsel(const Reader &reader, const std::vector<size_t> &offsets, size_t i,
+                        Function &&function) {
+  auto rows = chunk_bounds(reader, offsets, i);
+  for (; rows.first != rows.second; ++rows.first)
+    function(*rows.first);
+}
+
+} // namespace detail
+
+// Calls fn(row) for every row of `reader` on `threads` threads (0 = one per
+// hardware thread), in no particular order. The buffer is split into
+// record-aligned morsels with split_points; every thread works through its
+// own run of morsels and then steals morsels from the others, which keeps
+// all threads busy when row widths vary. fn must be safe to call
+// concurrently
+template <class Reader, class Function>
+void parallel_for_each(const Reader &reader, Function fn, size_t threads = 0) {
+  threads = detail::thread_count(threads);
+  const auto offsets = split_points(reader, detail::morsel_count(reader.size(), threads));
+  detail::stealing_for(offsets.size() - 1, threads, [&](size_t, size_t morsel) {
+    detail::for_each_in_morsel(reader, offsets, morsel, fn);
+  });
+}
+
+// Same, with per-thread state for aggregations without locks: every thread
+// calls fn(state, row) on its own state from init(), and after the join the
+// states are combined, in thread order, with merge(result, state) into a
+// result from init(), which is returned
+template <class Reader, class Init, class Function, class Merge>
+auto parallel_for_each(const Reader &reader, Init init, Function fn, Merge merge,
+                       size_t threads = 0) -> decltype(init()) {
+  typedef decltype(init()) State;
+  threads = detail::thread_count(threads);
+  const auto offsets = split_points(reader, detail::morsel_count(reader.size(), threads));
+  const size_t workers = std::min(threads, offsets.size() - 1);
+
+  // separate allocations keep the states of different threads apart
+  std::vector<std::unique_ptr<State>> states;
+  for (size_t i = 0; i < workers; ++i)
+    states.emplace_back(new State(init()));
+  detail::stealing_for(offsets.size() - 1, workers, [&](size_t worker, size_t morsel) {
+    State &state = *states[worker];
+    detail::for_each_in_morsel(reader, offsets, morsel,
+                               [&](const typename Reader::Row &row) { fn(state, row); });
+  });
+
+  State result = init();
+  for (auto &state : states)
+    merge(result, std::move(*state));
+  return result;
+}
+
+// Ordered pipeline: converts the rows of `reader` with convert(row) on
+// `threads` worker threads (0 = one per hardware thread), and calls
+// consume(value) with the results on the calling thread, strictly in file
+// order. Workers claim record-aligned morsels and convert them into the
+// slots of a bounded ring; the calling thread consumes the slots in morsel
+// order. A worker waits while its morsel is more than 2 * threads morsels
+// ahead of the consumer (backpressure). Slots are handed over through
+// atomic sequence numbers, without locks. The first exception thrown by
+// convert or consume stops the pipeline and is rethrown
+template <class Reader, class Convert, class Consume>
+void ordered_for_each(const Reader &reader, Convert convert, Consume consume, size_t threads = 0) {
+  typedef typename Reader::Row Row;
+  typedef typename std::decay<decltype(convert(std::declval<const Row &>()))>::type Value;
+  struct Slot {
+    std::atomic<size_t> ready{0}; // morsel + 1 once converted
+    std::vector<Value> values;
+  };
+
+  threads = detail::thread_count(threads);
+  const auto offsets = split_points(reader, detail::morsel_count(reader.size(), threads));
+  const size_t morsels = offsets.size() - 1, capacity = 2 * threads;
+  std::unique_ptr<Slot[]> slots(new Slot[capacity]);
+  std::atomic<size_t> next{0}, consumed{0};
+  std::atomic<bool> stop{false};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto fail = [&]() {
+    std::lock_guard<std::mutex> lock(error_mutex);
+    if (!error)
+      error = std::current_exception();
+    stop = true;
+  };
+
+  auto worker = [&]() {
+    for (size_t morsel; !stop && (morsel = next.fetch_add(1)) < morsels;) {
+      while (morsel >= consumed.load(std::memory_order_acquire) + capacity) {
+        if (stop)
+          return;
+        std::this_thread::yield();
+      }
+      Slot &slot = slots[morsel % capacity];
+      try {
+        detail::for_each_in_morsel(reader, offsets, morsel,
+                                   [&](const Row &row) { slot.values.push_back(convert(row)); });
+      } catch (...) {
+        fail();
+        return;
+      }
+      slot.ready.store(morsel + 1, std::memory_order_release);
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (size_t i = 0; i < threads; ++i)
+    pool.emplace_back(worker);
+  try {
+    for (size_t morsel = 0; morsel < morsels; ++morsel) {
+      Slot &slot = slots[morsel % capacity];
+      while (!stop && slot.ready.load(std::memory_order_acquire) != morsel + 1)
+        std::this_thread::yield();
+      if (stop)
+        break;
+      for (auto &value : slot.values)
+        consume(std::move(value));
+      slot.values.clear();
+      consumed.store(morsel + 1, std::memory_order_release);
+    }
+  } catch (...) {
+    fail();
+  }
+  for (auto &thread : pool)
+    thread.join();
+  if (error)
+    std::rethrow_exception(error);
+}
+
+// Handle to a run of whole rows of a Reader: the rows starting in
+// [begin, end) of its buffer. Cheap to copy; the rows stay in the buffer
+struct RowSpan {
+  size_t begin;
+  size_t end;
+};
+
+// Splits the rows of `reader` into up to `count` non-empty, record-aligned
+// RowSpans (see split_points) that together cover exactly the rows of
+// reader.begin()..reader.end()
+template <class Reader> std::vector<RowSpan> row_spans(const Reader &reader, size_t count) {
+  const auto offsets = split_points(reader, count);
+  const auto last = reader.end();
+  std::vector<RowSpan> result;
+  for (size_t i = 0; i + 1 < offsets.size(); ++i) {
+    // the last span runs up to end(), after the trailing empty row
+    const size_t end = i + 2 == offsets.size() ? reader.size() + 1 : offsets[i + 1];
+    auto first = i == 0 ? reader.begin() : detail::split_iterator(reader, offsets[i]);
+    if (offsets[i] < end && first != last)
+      result.push_back(RowSpan{offsets[i], end});
+  }
+  return result;
+}
+
+// Calls fn(row) for the rows in `span`
+template <class Reader, class Function>
+void for_each_row(const Reader &reader, RowSpan span, Function &&fn) {
+  auto last = detail::split_iterator(reader, span.end);
+  for (auto it = detail::split_iterator(reader, span.begin); it != last; ++it)
+    fn(*it);
+}
+
+// Bounded lock-free multi-producer multi-consumer queue, for handing
+// RowSpans (or other small handles) from producer to consumer threads:
+//
+//   BoundedQueue<RowSpan> queue(1024);
+//   producers: for (auto span : row_spans(csv, n)) queue.push(span);
+//              ... and queue.close() once all producers are done
+//   consumers: for (RowSpan span; queue.pop(span);)
+//                for_each_row(csv, span, [](const Row &row) { ... });
+//
+// Every slot carries a sequence number that tells whether it is free for
+// the push, or filled for the pop, at a given position; producers and
+// consumers claim positions with a compare-and-swap on their own counter
+// and never wait on a lock. The capacity is rounded up to a power of two
+template <class T> class BoundedQueue {
+  struct Slot {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;
+  char padding0_[64];
+  std::atomic<size_t> enqueue_{0}; // next position to push
+  char padding1_[64];
+  std::atomic<size_t> dequeue_{0}; // next position to pop
+  char padding2_[64];
+  std::atomic<bool> closed_{false};
+
+public:
+  explicit BoundedQueue(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity)
+      size *= 2;
+    slots_.reset(new Slot[size]);
+    mask_ = size - 1;
+    for (size_t i = 0; i < size; ++i)
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  BoundedQueue(const BoundedQueue &) = delete;
+  BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+  size_t capacity() const { return mask_ + 1; }
+
+  // Pushes `value` unless the queue is full
+  bool try_push(const T &value) {
+    size_t position = enqueue_.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+      slot = &slots_[position & mask_];
+      const intptr_t difference =
+          intptr_t(slot->sequence.load(std::memory_order_acquire)) - intptr_t(position);
+      if (difference == 0) {
+        if (enqueue_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+          break;
+      } else if (difference < 0) {
+        return false; // the slot still holds the value pushed a lap ago
+      } else {
+        position = enqueue_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->value = value;
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Pops the oldest value into `value` unless the queue is empty
+  bool try_pop(T &value) {
+    size_t position = dequeue_.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+      slot = &slots_[position & mask_];
+      const intptr_t difference =
+          intptr_t(slot->sequence.load(std::memory_order_acquire)) - intptr_t(position + 1);
+      if (difference == 0) {
+        if (dequeue_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+          break;
+      } else if (difference < 0) {
+        return false; // not pushed yet
+      } else {
+        position = dequeue_.load(std::memory_order_relaxed);
+      }
+    }
+    value = std::move(slot->value);
+    slot->sequence.store(position + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Pushes `value`, yielding while the queue is full
+  void push(const T &value) {
+    while (!try_push(value))
+      std::this_thread::yield();
+  }
+
+  // No more pushes; pop() returns false once the queue is drained. Call
+  // after all producers are done
+  void close() { closed_.store(true, std::memory_order_release); }
+
+  // Pops the oldest value, yielding while the queue is empty; false once
+  // the queue is closed and empty
+  bool pop(T &value) {
+    for (;;) {
+      if (try_pop(value))
+        return true;
+      if (closed_.load(std::memory_order_acquire))
+        return try_pop(value);
+      std::this_thread::yield();
+    }
+  }
+};
+
+} // namespace csv2
+
+#pragma once
+#include <algorithm>
+#include <cstring>
+// #include <csv2/parameters.hpp>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#if __has_include(<sys/uio.h>)
+#define __CSV2_HAS_UIO_H__ 1
+#include <cerrno>
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace csv2 {
+
+template <class delimiter = delimiter<','>, typename Stream = std::ofstream> class Writer {
+  Stream &stream_; // output stream for the writer
+public:
+  Writer(Stream &stream) : stream_(stream) {}
+
+  ~Writer() {
+    stream_.close();
+  }
+
+  template <typename Container> void write_row(Container &&row) {
+    const auto &strings = std::forward<Container>(row);
+    const auto delimiter_string = std::string(1, delimiter::value);
+    std::copy(strings.begin(), strings.end() - 1,
+              std::ostream_iterator<std::string>(stream_, delimiter_string.c_str()));
+    stream_ << strings.back() << "\n";
+  }
+
+  template <typename Container> void write_rows(Container &&rows) {
+    const auto &container_of_rows = std::forward<Container>(rows);
+    for (const auto &row : container_of_rows) {
+      write_row(row);
+    }
+  }
+};
+
+// Writes rows as their raw bytes in the source buffer (Row::address(),
+// Row::length()), each followed by `terminator`. Rows that are adjacent in
+// the source buffer are merged into a single range, and pending ranges are
+// written in batches: with writev(2) for file descriptors, or with one
+// write() call per range for streams
+class PassthroughWriter {
+  std::ostream *stream_{nullptr}; // output stream, or
+  int fd_{-1};                    // output file descriptor
+  std::string terminator_;        // written after each row
+  std::vector<std::pair<const char *, size_t>> ranges_; // pending writes
+
+public:
+  PassthroughWriter(std::ostream &stream, std::string terminator = "\n")
+      : stream_(&stream), terminator_(std::move(terminator)) {}
+#if __CSV2_HAS_UIO_H__
+  PassthroughWriter(int fd, std::string terminator = "\n")
+      : fd_(fd), terminator_(std::move(terminator)) {}
+#endif
+
+  ~PassthroughWriter() {
+    try {
+      flush();
+    } catch (...) {
+    }
+  }
+
+  template <typename Row> void write_row(const Row &row) { write_raw(row.address(), row.length()); }
+
+  template <typename Container> void write_rows(Container &&rows) {
+    for (const auto &row : rows)
+      write_row(row);
+  }
+
+  // Writes [data, data + length) followed by the terminator
+  void write_raw(const char *data, size_t length) {
+    if (!ranges_.empty()) {
+      auto &last = ranges_.back();
+      const char *end = last.first + last.second;
+      if (end + terminator_.size() == data &&
+          memcmp(end, terminator_.data(), terminator_.size()) == 0) {
+        last.second += terminator_.size() + length;
+        return;
+      }
+    }
+    if (ranges_.size() == batch_size_)
+      flush();
+    ranges_.emplace_back(data, length);
+  }
+
+  // Writes all pending ranges; throws std::runtime_error if the output fails
+  void flush() {
+    if (ranges_.empty())
+      return;
+#if __CSV2_HAS_UIO_H__
+    if (!stream_) {
+      std::vector<iovec> vectors;
+      vectors.reserve(2 * ranges_.size());
+      for (const auto &range : ranges_) {
+        vectors.push_back(iovec{const_cast<char *>(range.first), range.second});
+        vectors.push_back(iovec{const_cast<char *>(terminator_.data()), terminator_.size()});
+      }
+      ranges_.clear();
+      write_vectors_(vectors.data(), vectors.size());
+      return;
+    }
+#endif
+    for (const auto &range : ranges_) {
+      stream_->write(range.first, static_cast<std::streamsize>(range.second));
+      stream_->write(terminator_.data(), static_cast<std::streamsize>(terminator_.size()));
+    }
+    ranges_.clear();
+    if (!*stream_)
+      throw std::runtime_error("csv2: failed to write rows");
+  }
+
+private:
+  constexpr static size_t batch_size_ = 512; // ranges per flush
+
+#if __CSV2_HAS_UIO_H__
+  // writev, resuming after partial writes
+  void write_vectors_(iovec *vectors, size_t count) {
+#ifdef IOV_MAX
+    const size_t limit = IOV_MAX;
+#else
+    const size_t limit = 1024;
+#endif
+    while (count > 0) {
+      const ssize_t written = ::writev(fd_, vectors, static_cast<int>(std::min(count, limit)));
+      if (written < 0 && errno == EINTR)
+        continue;
+      if (written < 0)
+        throw std::runtime_error("csv2: failed to write rows");
+      for (size_t remaining = static_cast<size_t>(written); count > 0;) {
+        if (remaining < vectors->iov_len) {
+          vectors->iov_base = static_cast<char *>(vectors->iov_base) + remaining;
+          vectors->iov_len -= remaining;
+          break;
+        }
+        remaining -= vectors->iov_len;
+        ++vectors;
+        --count;
+      }
+    }
+  }
+#endif
+};
+
+} // namespace csv2
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#if __has_include(<sys/inotify.h>)
+#define __CSV2_HAS_INOTIFY__ 1
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace csv2 {
+
+// Waits for appends to a file, for use with Reader::follow():
+//
+//   FileWatcher watcher("log.csv");
+//   while (running) {
+//     watcher.wait(std::chrono::milliseconds(500));
+//     csv.follow([](const auto &row) { ... });
+//   }
+//
+// Uses inotify where available, and falls back to polling the file size
+class FileWatcher {
+  std::string path_;                   // watched file
+  std::chrono::milliseconds interval_; // polling interval
+  std::streamoff size_{0};             // last seen file size (polling)
+  int fd_{-1};                         // inotify instance, -1 = polling
+
+public:
+  explicit FileWatcher(std::string path,
+                       std::chrono::milliseconds interval = std::chrono::milliseconds(10))
+      : path_(std::move(path)), interval_(interval), size_(size_of_(path_)) {
+#if __CSV2_HAS_INOTIFY__
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ >= 0 && inotify_add_watch(fd_, path_.c_str(), IN_MODIFY) < 0) {
+      close(fd_);
+      fd_ = -1;
+    }
+#endif
+  }
+
+  FileWatcher(const FileWatcher &) = delete;
+  FileWatcher &operator=(const FileWatcher &) = delete;
+
+  ~FileWatcher() {
+#if __CSV2_HAS_INOTIFY__
+    if (fd_ >= 0)
+      close(fd_);
+#endif
+  }
+
+  // Blocks until the file is modified or `timeout` expires; returns true if
+  // the file was modified
+  bool wait(std::chrono::milliseconds timeout) {
+#if __CSV2_HAS_INOTIFY__
+    if (fd_ >= 0) {
+      pollfd request{fd_, POLLIN, 0};
+      if (poll(&request, 1, static_cast<int>(timeout.count())) <= 0)
+        return false;
+      // drain the queued events
+      char events[4096];
+      while (read(fd_, events, sizeof(events)) > 0) {
+      }
+      return true;
+    }
+#endif
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    for (;;) {
+      const std::streamoff size = size_of_(path_);
+      if (size != size_) {
+        size_ = size;
+        return true;
+      }
+      const auto now = std::chrono::steady_clock::now();
+      if (now >= deadline)
+        return false;
+      std::this_thread::sleep_for(
+          std::min<std::chrono::steady_clock::duration>(interval_, deadline - now));
+    }
+  }
+
+private:
+  static std::streamoff size_of_(const std::string &path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    return file ? static_cast<std::streamoff>(file.tellg()) : 0;
+  }
+};
+
+} // namespace csv2
+#pragma once
+// Coroutine interface (C++20): csv2::generator<T>, csv2::rows(reader) and
+// the awaitable csv2::async_follower. Compiles to nothing before C++20
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 202002L) || __cplusplus >= 202002L) &&              \
+    __has_include(<coroutine>) && __has_include(<stop_token>)
+#define __CSV2_HAS_COROUTINES__ 1
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+// #include <csv2/follow.hpp>
+// #include <csv2/reader.hpp>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace csv2 {
+
+// Lazy sequence of T produced by a coroutine with co_yield. There is one
+// coroutine frame per generator; yielded values are referenced in place,
+// not copied. Destroying the generator cancels the coroutine
+template <class T> class generator {
+public:
+  struct promise_type {
+    const T *current_{nullptr};
+    std::exception_ptr exception_;
+
+    generator get_return_object() {
+      return generator(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    std::suspend_always yield_value(const T &value) noexcept {
+      current_ = std::addressof(value);
+      return {};
+    }
+    void return_void() noexcept {}
+    void unhandled_exception() { exception_ = std::current_exception(); }
+    template <class U> void await_transform(U &&) = delete; // no co_await in generators
+  };
+
+  class iterator {
+    std::coroutine_handle<promise_type> handle_;
+
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = T;
+
+    iterator() = default;
+    explicit iterator(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    iterator &operator++() {
+      handle_.resume();
+      if (handle_.done() && handle_.promise().exception_)
+        std::rethrow_exception(handle_.promise().exception_);
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+
+    const T &operator*() const { return *handle_.promise().current_; }
+
+    bool operator==(std::default_sentinel_t) const { return !handle_ || handle_.done(); }
+  };
+
+  generator(generator &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+  generator &operator=(generator &&other) noexcept {
+    if (this != &other) {
+      if (handle_)
+        handle_.destroy();
+      handle_ = std::exchange(other.handle_, {});
+    }
+    return *this;
+  }
+  generator(const generator &) = delete;
+  generator &operator=(const generator &) = delete;
+
+  ~generator() {
+    if (handle_)
+      handle_.destroy();
+  }
+
+  iterator begin() {
+    iterator result(handle_);
+    if (handle_)
+      ++result;
+    return result;
+  }
+  std::default_sentinel_t end() const noexcept { return {}; }
+
+private:
+  explicit generator(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+  std::coroutine_handle<promise_type> handle_;
+};
+
+// The rows visited by reader.begin()..reader.end(), as a generator; stops
+// early once `token` is stopped
+template <class Reader>
+generator<typename Reader::Row> rows(const Reader &reader, std::stop_token token = {}) {
+  for (auto it = reader.begin(), last = reader.end(); it != last && !token.stop_requested(); ++it)
+    co_yield *it;
+}
+
+// Awaitable follow mode for a Reader that mmap'ed `path`:
+//
+//   async_follower<Reader> follower(csv, "log.csv");
+//   for (;;) {
+//     auto rows = co_await follower.next(token);
+//     if (rows.empty()) break;   // stopped
+//     ...
+//   }
+//
+// next() completes right away if rows were appended already; otherwise it
+// suspends the coroutine, and the follower's waiter thread waits for
+// appends (FileWatcher) and then resumes the coroutine with the new rows.
+// It resumes with no rows once `token` is stopped. One coroutine at a time
+// may await a follower. Destroying the follower stops and joins the waiter
+// thread, and a suspended coroutine is then never resumed; destroying a
+// suspended coroutine withdraws its wait
+template <class Reader> class async_follower {
+public:
+  typedef typename Reader::Row Row;
+
+private:
+  // Shared with awaiters, which may outlive the follower
+  struct state {
+    std::mutex mutex;
+    std::condition_variable_any waiting;
+    std::coroutine_handle<> pending; // suspended coroutine, if any
+    std::stop_token token;           // of the pending wait
+    std::vector<Row> rows;           // rows for the pending wait
+  };
+
+  Reader &reader_;
+  FileWatcher watcher_;
+  std::chrono::milliseconds interval_; // how often `token` is checked
+  std::shared_ptr<state> state_;
+  std::jthread waiter_; // last member: stopped and joined first
+
+  // Collects the rows appended since the last call; state_->mutex is held
+  bool poll_() {
+    reader_.follow([this](const Row &row) { state_->rows.push_back(row); });
+    return !state_->rows.empty();
+  }
+
+  void wait_(std::stop_token stop) {
+    const std::shared_ptr<state> shared = state_;
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    while (!stop.stop_requested()) {
+      if (!shared->pending) {
+        shared->waiting.wait(lock, stop, [&shared]() { return bool(shared->pending); });
+        continue;
+      }
+      lock.unlock();
+      watcher_.wait(interval_);
+      lock.lock();
+      if (!shared->pending || (!shared->token.stop_requested() && !poll_()))
+        continue;
+      const auto handle = std::exchange(shared->pending, {});
+      lock.unlock();
+      handle.resume();
+      if (stop.stop_requested())
+        return; // the follower may be gone
+      lock.lock();
+    }
+  }
+
+public:
+  async_follower(Reader &reader, std::string path,
+                 std::chrono::milliseconds interval = std::chrono::milliseconds(100))
+      : reader_(reader), watcher_(std::move(path)), interval_(interval),
+        state_(std::make_shared<state>()) {}
+
+  async_follower(const async_follower &) = delete;
+  async_follower &operator=(const async_follower &) = delete;
+
+  ~async_follower() {
+    // destroyed by the coroutine the waiter thread resumed: let it finish
+    if (waiter_.joinable() && waiter_.get_id() == std::this_thread::get_id()) {
+      waiter_.request_stop();
+      waiter_.detach();
+    }
+  }
+
+  class awaiter {
+    async_follower *follower_;
+    std::shared_ptr<state> state_;
+    std::stop_token token_;
+    std::coroutine_handle<> handle_;
+
+  public:
+    awaiter(async_follower *follower, std::stop_token token)
+        : follower_(follower), state_(follower->state_), token_(std::move(token)) {}
+    awaiter(const awaiter &) = delete;
+    awaiter &operator=(const awaiter &) = delete;
+
+    // withdraws the wait if the coroutine is destroyed while suspended
+    ~awaiter() {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      if (handle_ && state_->pending == handle_)
+        state_->pending = {};
+    }
+
+    bool await_ready() {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      return token_.stop_requested() || follower_->poll_();
+    }
+
+    // the coroutine may be resumed before this returns, so the awaiter is
+    // not used after the handle is published
+    void await_suspend(std::coroutine_handle<> handle) {
+      handle_ = handle;
+      async_follower *follower = follower_;
+      const std::shared_ptr<state> shared = state_;
+      std::lock_guard<std::mutex> lock(shared->mutex);
+      shared->pending = handle;
+      shared->token = token_;
+      if (!follower->waiter_.joinable())
+        follower->waiter_ =
+            std::jthread([follower](std::stop_token stop) { follower->wait_(std::move(stop)); });
+      shared->waiting.notify_one();
+    }
+
+    std::vector<Row> await_resume() {
+      std::vector<Row> result;
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      result.swap(state_->rows);
+      return result;
+    }
+  };
+
+  // Rows appended since the last call (see Reader::follow); valid until the
+  // next call
+  awaiter next(std::stop_token token = {}) { return awaiter(this, std::move(token)); }
+};
+
+} // namespace csv2
+#endif
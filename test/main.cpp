@@ -1,6 +1,18 @@
 #include "doctest.hpp"
+#include <csv2/coroutine.hpp>
+#include <csv2/follow.hpp>
+#include <csv2/matrix.hpp>
+#include <csv2/pipeline.hpp>
 #include <csv2/reader.hpp>
+#include <csv2/schema.hpp>
+#include <csv2/writer.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 using namespace csv2;
 using doctest::test_suite;
@@ -384,4 +396,1279 @@ TEST_CASE("Parse the most basic of CSV buffers with double quotes with just deli
   size_t cols = cells / rows;
   REQUIRE(rows == 1);
   REQUIRE(cols == 6);
-}
\ No newline at end of file
+}
+TEST_CASE("Lookup columns by header name" * test_suite("Reader")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  const std::string buffer = "id, \"name\",price\n1,foo,2.5\n2,bar,3.75";
+  csv.parse(buffer);
+
+  REQUIRE(csv.cols() == 3);
+  REQUIRE(csv.column_index("id") == 0);
+  REQUIRE(csv.column_index("name") == 1);
+  REQUIRE(csv.column_index(std::string("price")) == 2);
+  REQUIRE(csv.column_index("missing") == std::string::npos);
+
+  const std::vector<std::string> expected_names{"foo", "bar"};
+  const std::vector<std::string> expected_prices{"2.5", "3.75"};
+
+  size_t rows{0};
+  for (const auto row : csv) {
+    std::string name, price, missing;
+    row.get("name").read_value(name);
+    row.get(2).read_value(price);
+    row.get("missing").read_value(missing);
+    REQUIRE(name == expected_names[rows]);
+    REQUIRE(price == expected_prices[rows]);
+    REQUIRE(missing.empty());
+
+    // names through pointers, and indices of any integer type
+    const char *column = "name";
+    std::string by_pointer, by_int, by_unsigned, by_long;
+    row.get(column).read_value(by_pointer);
+    row.get(1).read_value(by_int);
+    row.get(1u).read_value(by_unsigned);
+    row.get(1L).read_value(by_long);
+    REQUIRE(by_pointer == name);
+    REQUIRE(by_int == name);
+    REQUIRE(by_unsigned == name);
+    REQUIRE(by_long == name);
+    rows += 1;
+  }
+  REQUIRE(rows == 2);
+}
+
+TEST_CASE("Parse a header-only CSV buffer" * test_suite("Reader")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  const std::string buffer = "a,b,c";
+  csv.parse(buffer);
+
+  REQUIRE(csv.cols() == 3);
+  REQUIRE(csv.column_index("c") == 2);
+  REQUIRE(csv.header().length() == 5);
+
+  size_t rows{0};
+  for (const auto row : csv) {
+    (void)(row);
+    rows += 1;
+  }
+  REQUIRE(rows == 0);
+}
+
+TEST_CASE("Select a compile-time subset of columns" * test_suite("Reader")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  const std::string buffer = "a,b,c,d,e,f,g\n1,2,3,4,5,6,7\n8,9,10,11,12,13,14\n15,16";
+  csv.parse(buffer);
+
+  const std::vector<std::vector<std::string>> expected_cells{
+      {"6", "1", "4"}, {"13", "8", "11"}, {"", "15", ""}};
+
+  size_t rows{0};
+  for (const auto cells : csv.select<5, 0, 3>()) {
+    REQUIRE(cells.size() == 3);
+    for (size_t i = 0; i < cells.size(); ++i) {
+      std::string value;
+      cells[i].read_value(value);
+      REQUIRE(value == expected_cells[rows][i]);
+    }
+    rows += 1;
+  }
+  REQUIRE(rows == 3);
+}
+
+TEST_CASE("Convert cells to typed values" * test_suite("Reader")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<false>> csv;
+  const std::string buffer = "-42, 18446744073709551615,2.5e3,TRUE,\"a \"\"b\"\"\",x,";
+  csv.parse(buffer);
+
+  const auto row = *csv.begin();
+  REQUIRE(row.get(0).get<int>() == -42);
+  REQUIRE(row.get(1).get<uint64_t>() == 18446744073709551615ULL);
+  REQUIRE(row.get(2).get<double>() == 2500.0);
+  REQUIRE(row.get(3).get<bool>() == true);
+  REQUIRE(row.get(4).get<std::string>() == "a \"b\"");
+
+  int8_t small{0};
+  REQUIRE_FALSE(row.get(1).get(small));
+  unsigned value{0};
+  REQUIRE_FALSE(row.get(0).get(value));
+  REQUIRE_THROWS_AS(row.get(5).get<double>(), std::invalid_argument);
+  REQUIRE_THROWS_AS(row.get(6).get<int>(), std::invalid_argument);
+}
+
+TEST_CASE("Convert quoted cells like unquoted ones" * test_suite("Reader")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  const std::string buffer = "\"x\",\"y\",\"name\"\n\"1\",\"2.5\",\"say \"\"hi\"\"\"\n"
+                             "\"3\",\"-4\",\"NA\"";
+  csv.parse(buffer);
+
+  const auto row = *csv.begin();
+  REQUIRE(row.get("x").get<int>() == 1);
+  REQUIRE(row.get("y").get<double>() == 2.5);
+  REQUIRE(row.get("name").get<std::string>() == "say \"hi\"");
+  const auto values = row.as<int, double, std::string>();
+  REQUIRE(std::get<0>(values) == 1);
+  REQUIRE(std::get<2>(values) == "say \"hi\"");
+
+  const auto matrix = load_matrix<double>(csv, layout::row_major, 1, NullValues{"NA"});
+  REQUIRE(matrix.rows() == 2);
+  REQUIRE(matrix.failures().size() == 1); // "say ""hi"""
+  REQUIRE(matrix(1, 1) == -4.0);
+
+  SchemaOptions options;
+  options.nulls = NullValues{"NA"};
+  const auto schema = infer_schema(csv, options);
+  REQUIRE(schema.columns[0].type == data_type::integer);
+  REQUIRE(schema.columns[1].type == data_type::floating);
+  REQUIRE(schema.columns[2].type == data_type::string);
+  REQUIRE(schema.columns[2].nullable);
+
+  size_t matches{0};
+  for (const auto match : csv.filter(0, match::equals, "1")) {
+    REQUIRE(match.get(1).get<double>() == 2.5);
+    matches += 1;
+  }
+  REQUIRE(matches == 1);
+}
+
+struct Trade {
+  int64_t id;
+  double price;
+  std::string symbol;
+};
+
+TEST_CASE("Parse rows into tuples and aggregates" * test_suite("Reader")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  const std::string buffer = "id,price,symbol\n1,10.5,ABC\n2,-0.25,XYZ";
+  csv.parse(buffer);
+
+  const std::vector<int64_t> expected_ids{1, 2};
+  const std::vector<double> expected_prices{10.5, -0.25};
+  const std::vector<std::string> expected_symbols{"ABC", "XYZ"};
+
+  size_t rows{0};
+  for (const auto row : csv.as<int64_t, double, std::string>()) {
+    REQUIRE(std::get<0>(row) == expected_ids[rows]);
+    REQUIRE(std::get<1>(row) == expected_prices[rows]);
+    REQUIRE(std::get<2>(row) == expected_symbols[rows]);
+    rows += 1;
+  }
+  REQUIRE(rows == 2);
+
+  rows = 0;
+  for (const auto trade : csv.into<Trade>(&Trade::id, &Trade::price, &Trade::symbol)) {
+    REQUIRE(trade.id == expected_ids[rows]);
+    REQUIRE(trade.price == expected_prices[rows]);
+    REQUIRE(trade.symbol == expected_symbols[rows]);
+    rows += 1;
+  }
+  REQUIRE(rows == 2);
+}
+
+TEST_CASE("Load numeric CSV into a dense matrix" * test_suite("Matrix")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  const std::string buffer = "x,y,z\n1,2.5,-3e2\n4,oops,6\n\n7,8\n";
+  csv.parse(buffer);
+
+  for (const auto order : {layout::row_major, layout::column_major}) {
+    const auto matrix = load_matrix<double>(csv, order, 2);
+    REQUIRE(matrix.rows() == 3);
+    REQUIRE(matrix.cols() == 3);
+    REQUIRE(matrix(0, 0) == 1.0);
+    REQUIRE(matrix(0, 1) == 2.5);
+    REQUIRE(matrix(0, 2) == -300.0);
+    REQUIRE(matrix(1, 1) == 0.0);
+    REQUIRE(matrix(1, 2) == 6.0);
+    REQUIRE(matrix(2, 1) == 8.0);
+    REQUIRE(matrix.data()[1] == (order == layout::row_major ? 2.5 : 4.0));
+
+    REQUIRE(matrix.failures().size() == 2);
+    REQUIRE(matrix.failures()[0].row == 1);
+    REQUIRE(matrix.failures()[0].col == 1);
+    REQUIRE(matrix.failures()[1].row == 2);
+    REQUIRE(matrix.failures()[1].col == 2);
+  }
+}
+
+TEST_CASE("Load a large numeric CSV in parallel" * test_suite("Matrix")) {
+  std::string buffer = "a,b\n";
+  for (size_t i = 0; i < 100000; ++i)
+    buffer += std::to_string(i) + "," + std::to_string(i) + ".125\n";
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  csv.parse(buffer);
+
+  const auto matrix = load_matrix<double>(csv, layout::row_major, 4);
+  REQUIRE(matrix.rows() == 100000);
+  REQUIRE(matrix.failures().empty());
+  bool ordered = true;
+  for (size_t i = 0; i < matrix.rows(); ++i)
+    ordered = ordered && matrix(i, 0) == double(i) && matrix(i, 1) == double(i) + 0.125;
+  REQUIRE(ordered);
+}
+
+TEST_CASE("Infer column types and nullability from samples" * test_suite("Schema")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  std::string buffer = "id,score,flag,day,seen_at,name,empty\n";
+  for (size_t i = 0; i < 20000; ++i) {
+    buffer += std::to_string(i) + "," + std::to_string(i) + ".5," + (i % 2 ? "true" : "FALSE") +
+              ",2024-01-0" + std::to_string(1 + i % 9) + ",2024-01-02T10:00:0" +
+              std::to_string(i % 10) + "Z," + (i % 7 ? "bob" : "") + ",\n";
+  }
+  buffer += "20000,1e3,false,2024-12-31,2024-01-02 10:00,alice,\n";
+  csv.parse(buffer);
+
+  SchemaOptions options;
+  options.rows = 1000;
+  options.windows = 10;
+  options.threads = 4;
+  const auto schema = infer_schema(csv, options);
+
+  REQUIRE(schema.sampled_rows == 1000);
+  REQUIRE(schema.columns.size() == 7);
+  const std::vector<std::string> expected_names{"id",      "score", "flag", "day",
+                                                "seen_at", "name",  "empty"};
+  const std::vector<data_type> expected_types{
+      data_type::integer,   data_type::floating, data_type::boolean, data_type::date,
+      data_type::timestamp, data_type::string,   data_type::string};
+  const std::vector<bool> expected_nullable{false, false, false, false, false, true, true};
+  for (size_t i = 0; i < schema.columns.size(); ++i) {
+    REQUIRE(schema.columns[i].name == expected_names[i]);
+    REQUIRE(schema.columns[i].type == expected_types[i]);
+    REQUIRE(schema.columns[i].nullable == expected_nullable[i]);
+  }
+}
+
+TEST_CASE("Infer a schema with line breaks inside quoted cells" * test_suite("Schema")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>,
+         trim_policy::trim_whitespace, comment_character<'\0'>, skip_rows<0>,
+         ignore_empty_lines<false>, quoted_newlines<true>>
+      csv;
+  std::string buffer = "id,note,score\n";
+  for (size_t i = 0; i < 20000; ++i)
+    buffer += std::to_string(i) + ",\"line 1\n2,3\n4\"," + std::to_string(i) + ".5\n";
+  csv.parse(buffer);
+
+  SchemaOptions options;
+  options.rows = 1600;
+  options.windows = 16;
+  const auto schema = infer_schema(csv, options);
+  REQUIRE(schema.sampled_rows == 1600);
+  REQUIRE(schema.columns.size() == 3);
+  REQUIRE(schema.columns[0].type == data_type::integer);
+  REQUIRE(schema.columns[1].type == data_type::string);
+  REQUIRE(schema.columns[2].type == data_type::floating);
+  REQUIRE_FALSE(schema.columns[0].nullable);
+  REQUIRE_FALSE(schema.columns[2].nullable);
+}
+
+TEST_CASE("Parse ISO-8601 timestamps" * test_suite("Reader")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<false>> csv;
+  const std::string buffer = "1970-01-01,2000-02-29T12:34:56,2024-01-02T03:04:05.123456789Z,"
+                             "2024-01-02 03:04:05.5+01:30,1969-12-31T23:59:59-0100,"
+                             "2024-06-30T23:59,2023-02-29,2024-13-01,2024-01-02T24:00:00,"
+                             "2024-01-02T03:04:05+1,2024-01-02X03:04:05";
+  csv.parse(buffer);
+
+  const auto row = *csv.begin();
+  REQUIRE(row.get(0).get<timestamp>().nanoseconds == 0);
+  REQUIRE(row.get(1).get<timestamp>().nanoseconds == 951827696LL * 1000000000);
+  REQUIRE(row.get(2).get<timestamp>().nanoseconds == 1704164645LL * 1000000000 + 123456789);
+  REQUIRE(row.get(3).get<timestamp>().nanoseconds ==
+          (1704164645LL - 5400) * 1000000000 + 500000000);
+  REQUIRE(row.get(4).get<timestamp>().nanoseconds == 3599LL * 1000000000);
+  REQUIRE(row.get(5).get<timestamp>().nanoseconds == 1719791940LL * 1000000000);
+
+  timestamp value{0};
+  for (size_t i = 6; i < 11; ++i)
+    REQUIRE_FALSE(row.get(i).get(value));
+}
+
+TEST_CASE("Recognize null tokens and record them in validity bitmaps" * test_suite("Matrix")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  const std::string buffer = "a,b,c\n1,NA,3\n\\N,5, NULL \n7,,missing\n";
+  csv.parse(buffer);
+
+  const auto row = *csv.begin(0);
+  REQUIRE(row.get(1).is_null(NullValues()));
+  REQUIRE_FALSE(row.get(0).is_null(NullValues()));
+  REQUIRE(row.get(0).is_null(NullValues{"1", "a very long null token"}));
+
+  const auto matrix = load_matrix<double>(csv, layout::column_major);
+  REQUIRE(matrix.rows() == 3);
+  REQUIRE(matrix.null_count() == 4);
+  REQUIRE(matrix.failures().size() == 1);
+  const std::vector<bool> expected_valid{true, false, true, false, true, false, true, false, false};
+  for (size_t i = 0; i < expected_valid.size(); ++i)
+    REQUIRE(matrix.is_valid(i / 3, i % 3) == expected_valid[i]);
+  REQUIRE(matrix.validity().size() == 1);
+  REQUIRE(matrix.validity()[0] == 0xFFFFFFFFFFFFFE55ULL);
+
+  const auto custom = load_matrix<double>(csv, layout::row_major, 1, NullValues{"NA"});
+  REQUIRE(custom.null_count() == 1);
+  REQUIRE(custom.failures().size() == 4);
+}
+
+TEST_CASE("Parse CSV with CRLF line endings" * test_suite("Reader")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>,
+         trim_policy::no_trimming>
+      csv;
+  csv.mmap("inputs/test_16_crlf.csv");
+
+  std::string header;
+  csv.header().read_raw_value(header);
+  REQUIRE(header == "a,b,c");
+  REQUIRE(csv.column_index("c") == 2);
+
+  const std::vector<std::string> expected_cells{"1", "2", "3", "4", "5", "6"};
+
+  size_t rows{0}, cells{0};
+  for (const auto row : csv) {
+    rows += 1;
+    for (const auto cell : row) {
+      std::string value;
+      cell.read_value(value);
+      REQUIRE(value == expected_cells[cells++]);
+    }
+  }
+  REQUIRE(rows == 4); // includes the empty line and the empty last row
+  REQUIRE(cells == 6);
+  REQUIRE(csv.rows() == 4);
+  REQUIRE(csv.rows(true) == 2);
+
+  // a stray '\r' inside a line does not make it a line terminator
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> stray;
+  const std::string lf = "a\rx,b\n1,2\n3,4\n";
+  stray.parse(lf);
+  REQUIRE(stray.cols() == 2);
+  REQUIRE(stray.rows() == 3);
+  REQUIRE((*stray.begin()).get(1).get<int>() == 2);
+  const std::string crlf = "a\rx,b\r\n1,2\r\n3,4";
+  stray.parse(crlf);
+  REQUIRE(stray.cols() == 2);
+  REQUIRE(stray.rows() == 2);
+  std::string last;
+  (*stray.begin()).get(1).read_raw_value(last);
+  REQUIRE(last == "2");
+}
+
+TEST_CASE("Parse CSV with CR-only line endings" * test_suite("Reader")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<false>> csv;
+  const std::string buffer = "a,b\r1,2\r\r3,4";
+  csv.parse(buffer);
+
+  const std::vector<std::string> expected_cells{"a", "b", "1", "2", "3", "4"};
+
+  size_t rows{0}, cells{0};
+  for (const auto row : csv) {
+    rows += 1;
+    for (const auto cell : row) {
+      std::string value;
+      cell.read_value(value);
+      REQUIRE(value == expected_cells[cells++]);
+    }
+  }
+  REQUIRE(rows == 4);
+  REQUIRE(cells == 6);
+  REQUIRE(csv.rows() == 4);
+  REQUIRE(csv.rows(true) == 3);
+}
+
+TEST_CASE("Skip leading rows and comment lines" * test_suite("Reader")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>,
+         trim_policy::trim_whitespace, comment_character<'#'>, skip_rows<2>>
+      csv;
+  csv.mmap("inputs/test_17_preamble.csv");
+
+  std::string header;
+  csv.header().read_raw_value(header);
+  REQUIRE(header == "id,name");
+  REQUIRE(csv.cols() == 2);
+  REQUIRE(csv.column_index("name") == 1);
+
+  const std::vector<std::string> expected_cells{"1", "foo", "2", "bar"};
+
+  size_t rows{0}, cells{0};
+  for (const auto row : csv) {
+    rows += 1;
+    for (const auto cell : row) {
+      std::string value;
+      cell.read_value(value);
+      REQUIRE(value == expected_cells[cells++]);
+    }
+  }
+  REQUIRE(rows == 2);
+  REQUIRE(csv.rows() == 2);
+
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<false>,
+         trim_policy::trim_whitespace, comment_character<'#'>, skip_rows<2>>
+      no_header;
+  no_header.mmap("inputs/test_17_preamble.csv");
+  rows = 0;
+  for (const auto row : no_header) {
+    (void)(row);
+    rows += 1;
+  }
+  REQUIRE(rows == 3);
+  REQUIRE(no_header.rows() == 3);
+}
+
+TEST_CASE("Skip empty lines inside the row iterator" * test_suite("Reader")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<false>,
+         trim_policy::trim_whitespace, comment_character<'\0'>, skip_rows<0>,
+         ignore_empty_lines<true>>
+      csv;
+  csv.mmap("inputs/empty_lines.csv");
+
+  const std::vector<std::string> expected_cells{"a", "b", "c", "1", "2",  "3",  "4", "5",
+                                                "6", "7", "8", "9", "10", "11", "12"};
+
+  size_t rows{0}, cells{0};
+  for (const auto row : csv) {
+    rows += 1;
+    for (const auto cell : row) {
+      std::string value;
+      cell.read_value(value);
+      REQUIRE(value == expected_cells[cells++]);
+    }
+  }
+  REQUIRE(rows == 5);
+  REQUIRE(csv.rows() == 5);
+
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>,
+         trim_policy::trim_whitespace, comment_character<'#'>, skip_rows<0>,
+         ignore_empty_lines<true>>
+      sparse;
+  const std::string buffer = "\r\n  \r\na,b\r\n\r\n \t \r\n#x\r\n1,2\r\n\r\n   ";
+  sparse.parse(buffer);
+  REQUIRE(sparse.cols() == 2);
+  rows = 0;
+  for (const auto row : sparse) {
+    std::string value;
+    row.read_raw_value(value);
+    REQUIRE(value == "1,2");
+    rows += 1;
+  }
+  REQUIRE(rows == 1);
+  REQUIRE(sparse.rows() == 1);
+}
+
+TEST_CASE("Count rows with vectorized newline counting" * test_suite("Reader")) {
+  std::string buffer = "a,b\n";
+  for (size_t i = 0; i < 1000; ++i)
+    buffer += std::to_string(i) + ",\"line " + std::to_string(i) + "\"\n";
+  buffer += "x,y";
+
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  csv.parse(buffer);
+  REQUIRE(csv.rows() == 1001);
+
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<false>> no_header;
+  no_header.parse(buffer);
+  REQUIRE(no_header.rows() == 1002);
+
+  const char *chunk = "1,2\r\n3,4\r\n";
+  const auto count = detail::count_lines(chunk, strlen(chunk), '\n', '"', false);
+  REQUIRE(count.total == 2);
+  REQUIRE(count.outside == 2);
+}
+
+TEST_CASE("Parse and count rows with quoted newlines" * test_suite("Reader")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>,
+         trim_policy::trim_whitespace, comment_character<'\0'>, skip_rows<0>,
+         ignore_empty_lines<false>, quoted_newlines<true>>
+      csv;
+  std::string buffer = "id,\"multi\nline\"\n";
+  for (size_t i = 0; i < 200; ++i)
+    buffer += std::to_string(i) + ",\"a\n\"\"b\"\"\nc\"\n";
+  csv.parse(buffer);
+
+  REQUIRE(csv.cols() == 2);
+  REQUIRE(csv.column_index("multi\nline") == 1);
+  REQUIRE(csv.rows() == 201);
+
+  size_t rows{0};
+  for (const auto row : csv) {
+    if (rows < 200) {
+      std::string value;
+      row.get(1).read_value(value);
+      REQUIRE(value == "\"a\n\"b\"\nc\"");
+      REQUIRE(row.get(0).get<size_t>() == rows);
+    }
+    rows += 1;
+  }
+  REQUIRE(rows == 201);
+
+  const auto count = detail::count_lines(buffer.data(), buffer.size(), '\n', '"', true);
+  REQUIRE(count.outside == 201);
+  REQUIRE(count.total == 201 + 3 * 200 - 200 + 1);
+  REQUIRE_FALSE(count.odd);
+}
+
+TEST_CASE("Count lines in parallel chunks" * test_suite("Reader")) {
+  std::string buffer;
+  for (size_t i = 0; buffer.size() < 8192; ++i)
+    buffer += i % 5 ? std::to_string(i) + ",x\n" : std::to_string(i) + ",\"a\nb\"\n";
+  // 32 chunks (8 threads) of a multiple of 64 bytes, plus newlines in the remainder
+  for (size_t length : {32 * 64 * 3 + 5, 32 * 64 * 3, 12 * 64 * 2 + 63, 100, 1}) {
+    std::string text = buffer.substr(0, length);
+    text[length - 1] = '\n';
+    const auto expected = detail::count_lines(text.data(), length, '\n', '"', true);
+    for (size_t threads : {3, 8}) {
+      REQUIRE(detail::count_lines_parallel(text.data(), length, '\n', '"', true, 0, threads) ==
+              expected.outside);
+      REQUIRE(detail::count_lines_parallel(text.data(), length, '\n', '"', false, 0, threads) ==
+              expected.total);
+    }
+  }
+}
+
+TEST_CASE("Estimate row count from sampled windows" * test_suite("Reader")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  const std::string small = "a,b\n1,2\n3,4";
+  csv.parse(small);
+  auto estimate = csv.estimate_rows();
+  REQUIRE(estimate.exact);
+  REQUIRE(estimate.rows == 2);
+  REQUIRE(estimate.lower == 2);
+  REQUIRE(estimate.upper == 2);
+
+  std::string buffer = "id,name\n";
+  uint32_t state = 12345;
+  while (buffer.size() < (size_t(4) << 20)) {
+    state = state * 1103515245 + 12345;
+    buffer += std::to_string(state % 100000) + "," + std::string(state >> 26, 'x') + "\n";
+  }
+  csv.parse(buffer);
+  const size_t rows = csv.rows();
+  estimate = csv.estimate_rows(16);
+  REQUIRE_FALSE(estimate.exact);
+  REQUIRE(estimate.lower <= rows);
+  REQUIRE(estimate.upper >= rows);
+  REQUIRE(estimate.lower <= estimate.rows);
+  REQUIRE(estimate.upper >= estimate.rows);
+  REQUIRE(std::abs(double(estimate.rows) - double(rows)) < 0.05 * rows);
+}
+
+TEST_CASE("Filter rows on a column value" * test_suite("Reader")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>,
+         trim_policy::trim_whitespace, comment_character<'#'>>
+      csv;
+  const std::string buffer = "symbol,exchange,price\r\n"
+                             "AAPL,NASDAQ,189.5\r\n"
+                             "# NYSE halted\r\n"
+                             "IBM, NYSE ,141.2\r\n"
+                             "NYSE,LSE,10\r\n"
+                             "GE,\"NYSE Arca\",80.1\r\n"
+                             "KO,NYSE,60.3";
+  csv.parse(buffer);
+
+  std::vector<std::string> symbols;
+  for (const auto row : csv.filter(1, match::equals, "NYSE")) {
+    std::string value;
+    row.get(0).read_value(value);
+    symbols.push_back(value);
+    REQUIRE(row.get(2).get<double>() > 0);
+  }
+  REQUIRE(symbols == std::vector<std::string>{"IBM", "KO"});
+
+  symbols.clear();
+  for (const auto row : csv.filter(1, match::prefix, "NYSE")) {
+    std::string value;
+    row.get(0).read_value(value);
+    symbols.push_back(value);
+  }
+  REQUIRE(symbols == std::vector<std::string>{"IBM", "GE", "KO"});
+
+  size_t rows{0};
+  for (const auto row : csv.filter(1, match::contains, "SDA")) {
+    REQUIRE(row.get("symbol").get<std::string>() == "AAPL");
+    rows += 1;
+  }
+  REQUIRE(rows == 1);
+
+  rows = 0;
+  for (const auto row : csv.filter(5, match::contains, "NYSE")) {
+    (void)row;
+    rows += 1;
+  }
+  REQUIRE(rows == 0);
+
+  const std::string text = std::string(100, 'a') + "needle" + std::string(100, 'b');
+  REQUIRE(detail::find(text.data(), text.data() + text.size(), "needle", 6) == text.data() + 100);
+  REQUIRE(detail::find(text.data(), text.data() + text.size(), "needles", 7) == nullptr);
+}
+
+TEST_CASE("Copy raw rows with the passthrough writer" * test_suite("Writer")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  const std::string buffer = "a,b\n1,x\n2,y\n3,x\n4,x\n5,\"x\"\n6,z";
+  csv.parse(buffer);
+
+  std::ostringstream stream;
+  {
+    PassthroughWriter writer(stream);
+    writer.write_row(csv.header());
+    writer.write_rows(csv.filter(1, match::equals, "x"));
+  }
+  REQUIRE(stream.str() == "a,b\n1,x\n3,x\n4,x\n5,\"x\"\n");
+
+#if __CSV2_HAS_UIO_H__
+  FILE *file = tmpfile();
+  REQUIRE(file != nullptr);
+  {
+    PassthroughWriter writer(fileno(file));
+    for (const auto row : csv)
+      writer.write_row(row);
+  }
+  std::string contents(64, '\0');
+  rewind(file);
+  contents.resize(fread(&contents[0], 1, contents.size(), file));
+  fclose(file);
+  REQUIRE(contents == "1,x\n2,y\n3,x\n4,x\n5,\"x\"\n6,z\n");
+#endif
+}
+
+TEST_CASE("Limit to the first rows of a large file" * test_suite("Reader")) {
+  const char *path = "test_limit.csv";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << "id,value\n";
+    for (size_t i = 0; i < 100000; ++i)
+      file << i << ",\"row " << i << "\"\n";
+  }
+
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  csv.limit(5);
+  REQUIRE(csv.mmap(path));
+  REQUIRE(csv.size() < (size_t(1) << 20));
+  REQUIRE(csv.rows() == 5);
+  REQUIRE(csv.cols() == 2);
+  size_t rows{0};
+  for (const auto row : csv) {
+    REQUIRE(row.get(0).get<size_t>() == rows);
+    rows += 1;
+  }
+  REQUIRE(rows == 5);
+
+  // the limit lies beyond the first mapped window
+  csv.limit(20000);
+  REQUIRE(csv.mmap(path));
+  REQUIRE(csv.rows() == 20000);
+
+  csv.limit(0);
+  REQUIRE(csv.mmap(path));
+  REQUIRE(csv.rows() == 100001);
+  std::remove(path);
+
+  const std::string buffer = "a,b\r\n1,2\r\n3,4\r\n5,6\r\n";
+  csv.limit(2);
+  csv.parse(buffer);
+  REQUIRE(csv.rows() == 2);
+  rows = 0;
+  for (const auto row : csv) {
+    std::string value;
+    row.read_raw_value(value);
+    REQUIRE(value == (rows == 0 ? "1,2" : "3,4"));
+    rows += 1;
+  }
+  REQUIRE(rows == 2);
+}
+
+TEST_CASE("Read the last rows by scanning backwards" * test_suite("Reader")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>,
+         trim_policy::trim_whitespace, comment_character<'#'>, skip_rows<0>,
+         ignore_empty_lines<true>>
+      csv;
+  std::string buffer = "time,event\n";
+  for (size_t i = 0; i < 1000; ++i)
+    buffer += std::to_string(i) + ",event " + std::to_string(i) + "\n" + (i % 10 ? "" : "# mark\n");
+  csv.parse(buffer);
+
+  auto rows = csv.tail(3);
+  REQUIRE(rows.size() == 3);
+  for (size_t i = 0; i < 3; ++i)
+    REQUIRE(rows[i].get(0).get<size_t>() == 997 + i);
+  REQUIRE(csv.tail(2000).size() == 1000);
+  REQUIRE(csv.tail(2000).front().get(0).get<size_t>() == 0);
+  REQUIRE(csv.tail(0).empty());
+
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>,
+         trim_policy::trim_whitespace, comment_character<'\0'>, skip_rows<0>,
+         ignore_empty_lines<false>, quoted_newlines<true>>
+      quoted;
+  const std::string log = "id,message\r\n1,\"a\r\nb\"\r\n2,\"c\r\n\"\"d\"\"\r\n\"\r\n3,e";
+  quoted.parse(log);
+  const auto last = quoted.tail(2);
+  REQUIRE(last.size() == 2);
+  std::string first_value, second_value;
+  last[0].read_raw_value(first_value);
+  REQUIRE(first_value == "2,\"c\r\n\"\"d\"\"\r\n\"");
+  last[1].read_raw_value(second_value);
+  REQUIRE(second_value == "3,e");
+  REQUIRE(quoted.tail(5).size() == 3);
+  const std::string terminated = log + "\r\n";
+  quoted.parse(terminated);
+  REQUIRE(quoted.tail(5).size() == 3);
+  std::string last_value;
+  quoted.tail(1)[0].read_raw_value(last_value);
+  REQUIRE(last_value == "3,e");
+
+  // a trailing line terminator does not count as an empty last row
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> plain;
+  const std::string lines = "a,b\n1,x\n2,y\n3,z\n";
+  plain.parse(lines);
+  const auto latest = plain.tail(2);
+  REQUIRE(latest.size() == 2);
+  REQUIRE(latest[0].get("b").get<std::string>() == "y");
+  REQUIRE(latest[1].get("b").get<std::string>() == "z");
+  REQUIRE(plain.tail(1)[0].get(0).get<int>() == 3);
+  REQUIRE(plain.tail(10).size() == 3);
+  const std::string header_only = "a,b\n";
+  plain.parse(header_only);
+  REQUIRE(plain.tail(1).empty());
+}
+
+TEST_CASE("Follow rows appended to a growing file" * test_suite("Reader")) {
+  const char *path = "test_follow.csv";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << "id,event\n1,start\n2,ru";
+  }
+
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  csv.complete_rows(true);
+  REQUIRE(csv.mmap(path));
+  FileWatcher watcher(path);
+  std::vector<std::string> events;
+  for (const auto row : csv)
+    if (row.length() > 0)
+      events.push_back(row.get("event").get<std::string>());
+  REQUIRE(events == std::vector<std::string>{"start"}); // not the partial "2,ru"
+  REQUIRE(csv.followed() == 17);
+  events.clear();
+  std::vector<size_t> offsets;
+  const auto callback = [&](const decltype(csv)::Row &row) {
+    events.push_back(row.get("event").get<std::string>());
+    offsets.push_back(row.offset());
+  };
+  REQUIRE(csv.follow(callback) == 0);
+
+  {
+    std::ofstream file(path, std::ios::binary | std::ios::app);
+    file << "n\n3,st";
+  }
+  REQUIRE(watcher.wait(std::chrono::milliseconds(1000)));
+  const size_t base = csv.followed();
+  REQUIRE(csv.follow(callback) == 1);
+  REQUIRE(events == std::vector<std::string>{"run"});
+  REQUIRE(base + offsets[0] == 17); // file offset of "2,run"
+  REQUIRE(csv.followed() == 23);
+  REQUIRE(csv.follow(callback) == 0);
+
+  {
+    std::ofstream file(path, std::ios::binary | std::ios::app);
+    file << "op\n4,exit\n";
+  }
+  REQUIRE(watcher.wait(std::chrono::milliseconds(1000)));
+  REQUIRE(csv.follow(callback) == 2);
+  REQUIRE(events == std::vector<std::string>{"run", "stop", "exit"});
+  REQUIRE_FALSE(watcher.wait(std::chrono::milliseconds(10)));
+
+  // mapped before the header line was complete
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << "a,b";
+  }
+  decltype(csv) partial;
+  REQUIRE(partial.mmap(path));
+  REQUIRE(partial.follow(callback) == 0);
+  {
+    std::ofstream file(path, std::ios::binary | std::ios::app);
+    file << ",c\n1,2,3\n";
+  }
+  std::vector<std::string> cells;
+  REQUIRE(partial.follow([&](const decltype(csv)::Row &row) {
+    cells.push_back(row.get("c").get<std::string>());
+  }) == 1);
+  REQUIRE(cells == std::vector<std::string>{"3"});
+  REQUIRE(partial.cols() == 3);
+
+  // after limit(n), follow() picks up after the n-th row
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << "a\n1\n2\n3\n4\n";
+  }
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> limited;
+  limited.limit(2);
+  REQUIRE(limited.mmap(path));
+  std::vector<int> values;
+  for (const auto row : limited)
+    values.push_back(row.get(0).get<int>());
+  REQUIRE(values == std::vector<int>{1, 2});
+  values.clear();
+  REQUIRE(limited.follow([&](const decltype(limited)::Row &row) {
+    values.push_back(row.get(0).get<int>());
+  }) == 2);
+  REQUIRE(values == std::vector<int>{3, 4});
+  std::remove(path);
+}
+
+TEST_CASE("Resume iteration from a checkpointed row offset" * test_suite("Reader")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>,
+         trim_policy::trim_whitespace, comment_character<'\0'>, skip_rows<0>,
+         ignore_empty_lines<false>, quoted_newlines<true>>
+      csv;
+  std::string buffer = "id,note\n";
+  for (size_t i = 0; i < 300; ++i)
+    buffer += std::to_string(i) + (i % 3 ? ",plain\n" : ",\"two\nlines, \"\"quoted\"\"\"\n");
+  csv.parse(buffer);
+
+  std::vector<size_t> offsets;
+  for (const auto row : csv)
+    offsets.push_back(row.offset());
+  REQUIRE(offsets.size() == 301);
+
+  // resume from a checkpoint
+  size_t id = 150;
+  for (auto it = csv.begin(offsets[150]), last = csv.end(); it != last; ++it) {
+    const auto row = *it;
+    if (id < 300)
+      REQUIRE(row.get(0).get<size_t>() == id);
+    id += 1;
+  }
+  REQUIRE(id == 301);
+
+  // resync from arbitrary offsets, also inside quoted cells
+  for (size_t offset = 1; offset < buffer.size(); offset += 7) {
+    const auto expected = std::lower_bound(offsets.begin(), offsets.end(), offset);
+    auto it = csv.begin(offset);
+    if (expected == offsets.end()) {
+      REQUIRE_FALSE(it != csv.end());
+    } else {
+      REQUIRE((*it).offset() == *expected);
+    }
+  }
+}
+
+TEST_CASE("Split a file at row boundaries and map single chunks" * test_suite("Reader")) {
+  typedef Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>,
+                 trim_policy::trim_whitespace, comment_character<'\0'>, skip_rows<0>,
+                 ignore_empty_lines<false>, quoted_newlines<true>>
+      QuotedReader;
+  const char *path = "test_split.csv";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << "id,note\n";
+    for (size_t i = 0; i < 5000; ++i)
+      file << i << (i % 4 ? ",plain\n" : ",\"multi\nline\"\n");
+  }
+
+  QuotedReader csv;
+  REQUIRE(csv.mmap(path));
+  std::vector<size_t> starts;
+  for (const auto row : csv)
+    starts.push_back(row.offset());
+
+  const auto offsets = split_points(csv, 4);
+  REQUIRE(offsets.size() == 5);
+  REQUIRE(offsets.front() == starts.front());
+  REQUIRE(offsets.back() == csv.size());
+  for (size_t i = 1; i < 4; ++i) {
+    REQUIRE(std::binary_search(starts.begin(), starts.end(), offsets[i]));
+    REQUIRE(offsets[i] - offsets[i - 1] < csv.size() / 3);
+  }
+
+  size_t next_id{0};
+  for (size_t i = 0; i < 4; ++i) {
+    QuotedReader chunk;
+    REQUIRE(chunk.mmap(path, offsets[i], offsets[i + 1] - offsets[i]));
+    REQUIRE(chunk.column_index("note") == 1);
+    for (const auto row : chunk) {
+      if (row.length() == 0)
+        continue;
+      REQUIRE(row.get("id").get<size_t>() == next_id);
+      next_id += 1;
+    }
+  }
+  REQUIRE(next_id == 5000);
+  std::remove(path);
+}
+
+TEST_CASE("Sample rows uniformly at random" * test_suite("Reader")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  const std::string small = "id\n1\n2\n3\n";
+  csv.parse(small);
+  REQUIRE(sample(csv, 10, 1).size() == 3);
+  REQUIRE(sample(csv, 2, 1).size() == 2);
+
+  // half of the rows are 40 times longer than the others
+  std::string buffer = "id,payload\n";
+  for (size_t i = 0; i < 40000; ++i)
+    buffer += std::to_string(i) + "," + (i % 2 ? std::string(200, 'x') : "y") + "\n";
+  csv.parse(buffer);
+
+  size_t long_rows{0}, total{0};
+  for (uint64_t seed = 0; seed < 20; ++seed) {
+    const auto rows = sample(csv, 100, seed);
+    REQUIRE(rows.size() == 100);
+    for (size_t i = 0; i < rows.size(); ++i) {
+      if (i > 0)
+        REQUIRE(rows[i - 1].offset() < rows[i].offset());
+      if (rows[i].get(0).get<size_t>() % 2)
+        long_rows += 1;
+      total += 1;
+    }
+  }
+  REQUIRE(long_rows > total * 4 / 10);
+  REQUIRE(long_rows < total * 6 / 10);
+}
+
+TEST_CASE("Aggregate rows in parallel with per-thread state" * test_suite("Parallel")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  std::string buffer = "id,payload,value\n";
+  for (size_t i = 0; i < 200000; ++i)
+    buffer += std::to_string(i) + "," + std::string(i % 1000 == 0 ? 5000 : i % 7, 'x') + "," +
+              std::to_string(i % 13) + "\n";
+  csv.parse(buffer);
+
+  std::atomic<size_t> rows{0};
+  parallel_for_each(csv, [&](const decltype(csv)::Row &row) { rows += row.length() > 0; }, 4);
+  REQUIRE(rows == 200000);
+
+  struct Totals {
+    size_t rows;
+    size_t ids;
+    int64_t values;
+  };
+  const auto totals = parallel_for_each(
+      csv, [] { return Totals{0, 0, 0}; },
+      [](Totals &state, const decltype(csv)::Row &row) {
+        if (row.length() == 0)
+          return;
+        state.rows += 1;
+        state.ids += row.get(0).get<size_t>();
+        state.values += row.get(2).get<int64_t>();
+      },
+      [](Totals &result, const Totals &state) {
+        result.rows += state.rows;
+        result.ids += state.ids;
+        result.values += state.values;
+      });
+  REQUIRE(totals.rows == 200000);
+  REQUIRE(totals.ids == size_t(200000) * 199999 / 2);
+  int64_t values{0};
+  for (size_t i = 0; i < 200000; ++i)
+    values += i % 13;
+  REQUIRE(totals.values == values);
+}
+
+TEST_CASE("Parallel rows end with a long last row" * test_suite("Parallel")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  for (const std::string terminator : {"", "\n"}) {
+    // the last row is longer than a morsel, so split points are clamped to the end
+    const std::string buffer = "id\n1\n" + std::string(9000, 'x') + terminator;
+    csv.parse(buffer);
+    std::vector<size_t> expected;
+    for (const auto row : csv)
+      expected.push_back(row.length());
+
+    for (size_t threads : {1, 4}) {
+      std::mutex mutex;
+      std::vector<size_t> lengths;
+      parallel_for_each(
+          csv,
+          [&](const decltype(csv)::Row &row) {
+            std::lock_guard<std::mutex> lock(mutex);
+            lengths.push_back(row.length());
+          },
+          threads);
+      std::sort(lengths.begin(), lengths.end());
+      std::sort(expected.begin(), expected.end());
+      REQUIRE(lengths == expected);
+    }
+  }
+}
+
+TEST_CASE("Convert rows in parallel and consume them in order" * test_suite("Parallel")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  std::string buffer = "id,payload\n";
+  for (size_t i = 0; i < 100000; ++i)
+    buffer += std::to_string(i) + "," + std::string(i % 5000 < 50 ? 2000 : 3, 'x') + "\n";
+  buffer += "100000,end";
+  csv.parse(buffer);
+
+  typedef decltype(csv)::Row Row;
+  size_t expected{0};
+  bool ordered{true};
+  ordered_for_each(
+      csv, [](const Row &row) { return row.get(0).get<size_t>(); },
+      [&](size_t id) {
+        ordered = ordered && id == expected;
+        expected += 1;
+      },
+      4);
+  REQUIRE(ordered);
+  REQUIRE(expected == 100001);
+
+  // exceptions in workers stop the pipeline
+  REQUIRE_THROWS_AS(ordered_for_each(
+                        csv,
+                        [](const Row &row) {
+                          if (row.get(1).get<std::string>() == "end")
+                            throw std::runtime_error("last row");
+                          return row.length();
+                        },
+                        [](size_t) {}, 4),
+                    std::runtime_error);
+}
+
+TEST_CASE("Ordered rows end with a long last row" * test_suite("Parallel")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  for (const std::string terminator : {"", "\n"}) {
+    const std::string buffer = "id\n1\n" + std::string(9000, 'x') + terminator;
+    csv.parse(buffer);
+    std::vector<size_t> expected;
+    for (const auto row : csv)
+      expected.push_back(row.length());
+
+    for (size_t threads : {1, 4}) {
+      std::vector<size_t> lengths;
+      ordered_for_each(
+          csv, [](const decltype(csv)::Row &row) { return row.length(); },
+          [&](size_t length) { lengths.push_back(length); }, threads);
+      REQUIRE(lengths == expected);
+    }
+  }
+}
+
+TEST_CASE("Hand row ranges from producers to consumers through a bounded queue" *
+          test_suite("Parallel")) {
+  BoundedQueue<int> small(3);
+  REQUIRE(small.capacity() == 4);
+  for (int i = 0; i < 4; ++i)
+    REQUIRE(small.try_push(i));
+  REQUIRE_FALSE(small.try_push(4));
+  int value{0};
+  REQUIRE(small.try_pop(value));
+  REQUIRE(value == 0);
+  REQUIRE(small.try_push(4));
+  for (int i = 1; i <= 4; ++i) {
+    REQUIRE(small.try_pop(value));
+    REQUIRE(value == i);
+  }
+  REQUIRE_FALSE(small.try_pop(value));
+
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  std::string buffer = "id,name\n";
+  for (size_t i = 0; i < 100000; ++i)
+    buffer += std::to_string(i) + (i % 3 ? ",\"x,y\"" : ",z") + (i == 99999 ? "" : "\n");
+  csv.parse(buffer);
+  using Row = decltype(csv)::Row;
+
+  const auto spans = row_spans(csv, 1000);
+  REQUIRE(spans.front().begin == (*csv.begin()).offset());
+  for (size_t i = 1; i < spans.size(); ++i)
+    REQUIRE(spans[i].begin == spans[i - 1].end);
+
+  BoundedQueue<RowSpan> queue(16);
+  std::atomic<size_t> next{0}, producers_left{2}, rows{0}, ids{0};
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < 2; ++i)
+    threads.emplace_back([&]() {
+      for (size_t index; (index = next.fetch_add(1)) < spans.size();)
+        queue.push(spans[index]);
+      if (producers_left.fetch_sub(1) == 1)
+        queue.close();
+    });
+  for (size_t i = 0; i < 4; ++i)
+    threads.emplace_back([&]() {
+      for (RowSpan span; queue.pop(span);)
+        for_each_row(csv, span, [&](const Row &row) {
+          rows += 1;
+          ids += row.get(0).get<size_t>();
+        });
+    });
+  for (auto &thread : threads)
+    thread.join();
+  REQUIRE(rows == 100000);
+  REQUIRE(ids == size_t(99999) * 100000 / 2);
+
+  // a last row longer than a span: no runaway spans, no extra empty rows
+  for (const std::string terminator : {"", "\n"}) {
+    const std::string tail = "id\n1\n" + std::string(9000, 'x') + terminator;
+    csv.parse(tail);
+    std::vector<size_t> expected, lengths;
+    for (const auto row : csv)
+      expected.push_back(row.length());
+    const auto tail_spans = row_spans(csv, 2);
+    REQUIRE(tail_spans.size() == (terminator.empty() ? 1 : 2));
+    for (const auto &span : tail_spans)
+      for_each_row(csv, span, [&](const Row &row) { lengths.push_back(row.length()); });
+    REQUIRE(lengths == expected);
+  }
+}
+
+TEST_CASE("Iterate over rows in batches" * test_suite("Reader")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  std::string buffer = "id,name,value\n";
+  for (size_t i = 0; i < 2500; ++i)
+    buffer += std::to_string(i) + (i % 2 ? ",\"a,\"\"b\"\"\"," : ",plain,") + std::to_string(i * 2) +
+              (i == 2499 ? "" : "\n");
+  csv.parse(buffer);
+
+  std::vector<size_t> sizes;
+  size_t next_id{0};
+  int64_t total{0};
+  for (const auto &batch : csv.batches(1024)) {
+    sizes.push_back(batch.size());
+    REQUIRE(batch.cell_index().size() == batch.size() + 1);
+    for (size_t i = 0; i < batch.size(); ++i) {
+      REQUIRE(batch.cells(i) == 3);
+      REQUIRE(batch.cell(i, 0).get<size_t>() == next_id);
+      total += batch.cell(i, 2).get<int64_t>();
+      REQUIRE(batch.row(i).offset() == batch.row_starts()[i]);
+      if (next_id % 2) {
+        std::string value;
+        batch.cell(i, 1).read_value(value);
+        REQUIRE(value == "\"a,\"b\"\"");
+      }
+      next_id += 1;
+    }
+    REQUIRE(batch.cell(0, 3).get<std::string>() == "");
+  }
+  REQUIRE(sizes == std::vector<size_t>{1024, 1024, 452});
+  REQUIRE(next_id == 2500);
+  REQUIRE(total == int64_t(2499) * 2500);
+
+  // blocks of the same size at different positions are different iterators
+  const auto batches = csv.batches(1000);
+  auto first = batches.begin(), second = batches.begin();
+  ++second;
+  REQUIRE((first != second));
+  REQUIRE_FALSE((second != second));
+  ++first;
+  REQUIRE_FALSE((first != second));
+  ++first;
+  ++first;
+  REQUIRE_FALSE((first != batches.end()));
+}
+
+#ifdef __CSV2_HAS_COROUTINES__
+TEST_CASE("Generate rows with a coroutine" * test_suite("Reader")) {
+  Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>> csv;
+  const std::string buffer = "id,name\n1,a\n2,b\n3,c\n4,d";
+  csv.parse(buffer);
+
+  std::vector<std::string> names;
+  for (const auto &row : csv2::rows(csv))
+    names.push_back(row.get("name").get<std::string>());
+  REQUIRE(names == std::vector<std::string>{"a", "b", "c", "d"});
+
+  std::stop_source stop;
+  names.clear();
+  for (const auto &row : csv2::rows(csv, stop.get_token())) {
+    names.push_back(row.get("name").get<std::string>());
+    if (names.size() == 2)
+      stop.request_stop();
+  }
+  REQUIRE(names == std::vector<std::string>{"a", "b"});
+}
+
+namespace {
+// fire-and-forget coroutine, enough to drive async_follower in tests
+struct detached_task {
+  struct promise_type {
+    detached_task get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+// coroutine owned by the task, destroyed with it
+struct owned_task {
+  struct promise_type {
+    owned_task get_return_object() {
+      return owned_task{std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+  std::coroutine_handle<promise_type> handle;
+  ~owned_task() { handle.destroy(); }
+};
+} // namespace
+
+TEST_CASE("Await rows appended to a growing file" * test_suite("Reader")) {
+  const char *path = "test_async_follow.csv";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << "id,event\n1,start\n";
+  }
+
+  using CSV = Reader<delimiter<','>, quote_character<'"'>, first_row_is_header<true>>;
+  CSV csv;
+  REQUIRE(csv.mmap(path));
+  csv2::async_follower<CSV> follower(csv, path, std::chrono::milliseconds(10));
+  std::stop_source stop;
+  std::vector<std::string> events;
+  std::atomic<size_t> received{0};
+  std::atomic<bool> done{false};
+
+  [](csv2::async_follower<CSV> &follower, std::stop_token token, std::vector<std::string> &events,
+     std::atomic<size_t> &received, std::atomic<bool> &done) -> detached_task {
+    for (;;) {
+      const auto rows = co_await follower.next(token);
+      if (rows.empty())
+        break;
+      for (const auto &row : rows)
+        events.push_back(row.get("event").get<std::string>());
+      received = events.size();
+    }
+    done = true;
+  }(follower, stop.get_token(), events, received, done);
+
+  {
+    std::ofstream file(path, std::ios::binary | std::ios::app);
+    file << "2,run\n3,stop\n";
+  }
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (received < 2 && std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  stop.request_stop();
+  while (!done)
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  REQUIRE(events == std::vector<std::string>{"run", "stop"});
+
+  const auto await_once = [](csv2::async_follower<CSV> &follower,
+                             std::atomic<bool> &resumed) -> owned_task {
+    co_await follower.next();
+    resumed = true;
+  };
+  std::atomic<bool> resumed{false};
+  {
+    // the follower is destroyed while the coroutine is suspended
+    CSV reader;
+    REQUIRE(reader.mmap(path));
+    auto follower = std::make_unique<csv2::async_follower<CSV>>(reader, path,
+                                                                std::chrono::milliseconds(10));
+    owned_task task = await_once(*follower, resumed);
+    follower.reset();
+  }
+  {
+    // the coroutine is destroyed while suspended, then rows are appended
+    CSV reader;
+    REQUIRE(reader.mmap(path));
+    csv2::async_follower<CSV> follower(reader, path, std::chrono::milliseconds(10));
+    { owned_task task = await_once(follower, resumed); }
+    {
+      std::ofstream file(path, std::ios::binary | std::ios::app);
+      file << "4,exit\n";
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  REQUIRE_FALSE(resumed);
+  std::remove(path);
+}
+#endif